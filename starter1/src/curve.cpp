@@ -47,7 +47,9 @@ Curve evalBezier(const vector< Vector3f >& P, unsigned steps) {
 			P[i * 3][2], P[i * 3 + 1][2], P[i * 3 + 2][2], P[i * 3 + 3][2],
 			0, 0, 0, 0);
 
-		// P = GMT
+		// P = GMT; GM is fixed for the piece, so each step is a single
+		// matrix-vector product
+		const Matrix4f GM = G_bezier * M_bez;
 		for (unsigned q = 0; q <= steps; ++q){
 
 			if (i != 0 && q == 0){
@@ -64,8 +66,8 @@ Curve evalBezier(const vector< Vector3f >& P, unsigned steps) {
 
 			// compute the curve point and tangent
 			CurvePoint cp;
-			cp.V = (G_bezier * M_bez * T_normal).xyz();
-			cp.T = (G_bezier * M_bez * T_tangent).xyz().normalized();
+			cp.V = (GM * T_normal).xyz();
+			cp.T = (GM * T_tangent).xyz().normalized();
 
 			// next, we compute the N and B vectors
 			Vector3f B_0 = Vector3f(0, 0, 1);
@@ -14,6 +14,23 @@ namespace{
 
         return true;
     }
+
+    // Vertices and normals of a curve in structure-of-arrays form, the
+    // layout Matrix4f's batch transforms vectorize over.
+    struct CurveSoA{
+        vector<float> vx, vy, vz;
+        vector<float> nx, ny, nz;
+
+        explicit CurveSoA(unsigned n) :
+            vx(n), vy(n), vz(n), nx(n), ny(n), nz(n) {}
+
+        explicit CurveSoA(const Curve& curve) : CurveSoA(curve.size()){
+            for (unsigned i = 0; i < curve.size(); i++){
+                vx[i] = curve[i].V[0]; vy[i] = curve[i].V[1]; vz[i] = curve[i].V[2];
+                nx[i] = curve[i].N[0]; ny[i] = curve[i].N[1]; nz[i] = curve[i].N[2];
+            }
+        }
+    };
 }
 
 // DEBUG HELPER
@@ -62,27 +79,24 @@ Surface makeSurfRev(const Curve& profile, unsigned steps){
     surface.VN.clear();
     surface.VF.clear();
 
-    // For each step, rotate the profile curve around the y-axis
+    // For each step, rotate the whole profile curve around the y-axis
+    const unsigned n = profile.size();
+    const CurveSoA in(profile);
+    CurveSoA out(n);
     for (unsigned i = 0; i <= steps; ++i){
         float t = (float) i / steps;
         float theta = 2.0f * M_PI * t;
 
-        // Create rotation matrix around y-axis
-        Matrix3f rot;
-        rot(0, 0) = cos(theta);  rot(0, 2) = sin(theta);
-        rot(1, 1) = 1.0f;
-        rot(2, 0) = -sin(theta); rot(2, 2) = cos(theta);
-
-        // Rotate each point in the profile curve
-        for (const auto& point : profile){
-            // Rotate vertex position
-            Vector3f rotatedV = rot * point.V;
-            surface.VV.push_back(rotatedV);
-
-            // Rotate normal (using the upper 3x3 part of the rotation matrix)
-            Vector3f rotatedN = rot * point.N;
-            rotatedN = -rotatedN;
-            surface.VN.push_back(rotatedN.normalized());
+        // A rotation is rigid, so normals transform like directions
+        Matrix4f rot = Matrix4f::rotateY(theta);
+        rot.transformPoints(in.vx.data(), in.vy.data(), in.vz.data(),
+                            out.vx.data(), out.vy.data(), out.vz.data(), n);
+        rot.transformDirections(in.nx.data(), in.ny.data(), in.nz.data(),
+                                out.nx.data(), out.ny.data(), out.nz.data(), n);
+
+        for (unsigned k = 0; k < n; ++k){
+            surface.VV.push_back(Vector3f(out.vx[k], out.vy[k], out.vz[k]));
+            surface.VN.push_back(-Vector3f(out.nx[k], out.ny[k], out.nz[k]).normalized());
         }
     }
 
@@ -121,20 +135,22 @@ Surface makeGenCyl(const Curve& profile, const Curve& sweep){
         cerr << "surfRev profile curve must be flat on xy plane." << endl;
         exit(0);
     }
-    
+
+    const unsigned n = profile.size();
+    const CurveSoA in(profile);
+    CurveSoA out(n);
     for (unsigned j = 0; j < sweep.size(); j++){
-        for (unsigned i = 0; i < profile.size(); i++){
-            // Create transformation matrix for the current sweep point
-            Matrix4f trans_M = generate_trans_M(sweep[j]);
-
-            // Transform vertex 
-            Vector4f transformed_V = trans_M * Vector4f(profile[i].V, 1.0f);
-            surface.VV.push_back(transformed_V.xyz());
-
-            // Transform normal
-            Vector4f transformed_N =
-                inverseTranspose(trans_M) * Vector4f(profile[i].N, 0.0f);
-            surface.VN.push_back(-transformed_N.xyz());
+        // Move the whole profile into the frame of the current sweep point;
+        // transformNormals applies the inverse transpose
+        Matrix4f trans_M = generate_trans_M(sweep[j]);
+        trans_M.transformPoints(in.vx.data(), in.vy.data(), in.vz.data(),
+                                out.vx.data(), out.vy.data(), out.vz.data(), n);
+        trans_M.transformNormals(in.nx.data(), in.ny.data(), in.nz.data(),
+                                 out.nx.data(), out.ny.data(), out.nz.data(), n);
+
+        for (unsigned i = 0; i < n; i++){
+            surface.VV.push_back(Vector3f(out.vx[i], out.vy[i], out.vz[i]));
+            surface.VN.push_back(-Vector3f(out.nx[i], out.ny[i], out.nz[i]));
         }
     }
 
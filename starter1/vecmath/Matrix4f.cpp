@@ -11,40 +11,6 @@
 #include "Vector3f.h"
 #include "Vector4f.h"
 
-Matrix4f::Matrix4f( float fill )
-{
-	for( int i = 0; i < 16; ++i )
-	{
-		m_elements[ i ] = fill;
-	}
-}
-
-Matrix4f::Matrix4f( float m00, float m01, float m02, float m03,
-				   float m10, float m11, float m12, float m13,
-				   float m20, float m21, float m22, float m23,
-				   float m30, float m31, float m32, float m33 )
-{
-	m_elements[ 0 ] = m00;
-	m_elements[ 1 ] = m10;
-	m_elements[ 2 ] = m20;
-	m_elements[ 3 ] = m30;
-	
-	m_elements[ 4 ] = m01;
-	m_elements[ 5 ] = m11;
-	m_elements[ 6 ] = m21;
-	m_elements[ 7 ] = m31;
-
-	m_elements[ 8 ] = m02;
-	m_elements[ 9 ] = m12;
-	m_elements[ 10 ] = m22;
-	m_elements[ 11 ] = m32;
-
-	m_elements[ 12 ] = m03;
-	m_elements[ 13 ] = m13;
-	m_elements[ 14 ] = m23;
-	m_elements[ 15 ] = m33;
-}
-
 Matrix4f& Matrix4f::operator/=(float d)
 {
 	for(int ii=0;ii<16;ii++){
@@ -71,72 +37,6 @@ Matrix4f::Matrix4f( const Vector4f& v0, const Vector4f& v1, const Vector4f& v2,
 	}
 }
 
-Matrix4f::Matrix4f( const Matrix4f& rm )
-{
-	memcpy( m_elements, rm.m_elements, sizeof(m_elements) );
-}
-
-Matrix4f& Matrix4f::operator = ( const Matrix4f& rm )
-{
-	if( this != &rm )
-	{
-		memcpy( m_elements, rm.m_elements, sizeof(m_elements)  );
-	}
-	return *this;
-}
-
-const float& Matrix4f::operator () ( int i, int j ) const
-{
-	return m_elements[ j * 4 + i ];
-}
-
-float& Matrix4f::operator () ( int i, int j )
-{
-	return m_elements[ j * 4 + i ];
-}
-
-Vector4f Matrix4f::getRow( int i ) const
-{
-	return Vector4f
-	(
-		m_elements[ i ],
-		m_elements[ i + 4 ],
-		m_elements[ i + 8 ],
-		m_elements[ i + 12 ]
-	);
-}
-
-void Matrix4f::setRow( int i, const Vector4f& v )
-{
-	m_elements[ i ] = v.x();
-	m_elements[ i + 4 ] = v.y();
-	m_elements[ i + 8 ] = v.z();
-	m_elements[ i + 12 ] = v.w();
-}
-
-Vector4f Matrix4f::getCol( int j ) const
-{
-	int colStart = 4 * j;
-
-	return Vector4f
-	(
-		m_elements[ colStart ],
-		m_elements[ colStart + 1 ],
-		m_elements[ colStart + 2 ],
-		m_elements[ colStart + 3 ]
-	);
-}
-
-void Matrix4f::setCol( int j, const Vector4f& v )
-{
-	int colStart = 4 * j;
-
-	m_elements[ colStart ] = v.x();
-	m_elements[ colStart + 1 ] = v.y();
-	m_elements[ colStart + 2 ] = v.z();
-	m_elements[ colStart + 3 ] = v.w();
-}
-
 Matrix2f Matrix4f::getSubmatrix2x2( int i0, int j0 ) const
 {
 	Matrix2f out;
@@ -225,6 +125,11 @@ float Matrix4f::determinant() const
  */
 Matrix4f Matrix4f::inverse(bool* pbIsSingular, float epsilon) const
 {
+	if( isAffine() )
+	{
+		return inverseAffine( pbIsSingular, epsilon );
+	}
+
 	float m00 = m_elements[ 0 ];
 	float m10 = m_elements[ 1 ];
 	float m20 = m_elements[ 2 ];
@@ -295,45 +200,155 @@ Matrix4f Matrix4f::inverse(bool* pbIsSingular, float epsilon) const
 	}
 }
 
-void Matrix4f::transpose()
+bool Matrix4f::isAffine() const
 {
-	float temp;
+	return m_elements[ 3 ] == 0 && m_elements[ 7 ] == 0 && m_elements[ 11 ] == 0 && m_elements[ 15 ] == 1;
+}
+
+bool Matrix4f::isRigid( float epsilon ) const
+{
+	if( !isAffine() )
+	{
+		return false;
+	}
 
+	// columns of the 3x3 block must be unit length and pairwise orthogonal
 	for( int i = 0; i < 3; ++i )
 	{
-		for( int j = i + 1; j < 4; ++j )
+		for( int j = i; j < 3; ++j )
 		{
-			temp = ( *this )( i, j );
-			( * this )( i, j ) = ( *this )( j, i );
-			( *this )( j, i ) = temp;
+			const float* ci = m_elements + 4 * i;
+			const float* cj = m_elements + 4 * j;
+			float d = ci[ 0 ] * cj[ 0 ] + ci[ 1 ] * cj[ 1 ] + ci[ 2 ] * cj[ 2 ];
+			if( fabs( d - ( i == j ? 1.0f : 0.0f ) ) > epsilon )
+			{
+				return false;
+			}
 		}
 	}
+	return true;
 }
 
-Matrix4f Matrix4f::transposed() const
+Matrix4f Matrix4f::inverseAffine( bool* pbIsSingular, float epsilon ) const
 {
+	bool isSingular;
+	Matrix3f a = getSubmatrix3x3( 0, 0 ).inverse( &isSingular, epsilon );
+	if( pbIsSingular != NULL )
+	{
+		*pbIsSingular = isSingular;
+	}
+	if( isSingular )
+	{
+		return Matrix4f();
+	}
+
+	Vector3f t = -( a * Vector3f( m_elements[ 12 ], m_elements[ 13 ], m_elements[ 14 ] ) );
+
 	Matrix4f out;
-	for( int i = 0; i < 4; ++i )
+	out.setSubmatrix3x3( 0, 0, a );
+	out.setCol( 3, Vector4f( t, 1 ) );
+	return out;
+}
+
+Matrix4f Matrix4f::inverseRigid() const
+{
+	Matrix4f out = transposed();
+	out.setRow( 3, Vector4f( 0, 0, 0, 1 ) );
+
+	const float* t = m_elements + 12;
+	for( int i = 0; i < 3; ++i )
+	{
+		const float* c = m_elements + 4 * i;
+		out( i, 3 ) = -( c[ 0 ] * t[ 0 ] + c[ 1 ] * t[ 1 ] + c[ 2 ] * t[ 2 ] );
+	}
+	return out;
+}
+
+// out = A * (x, y, z) + w * b for n vectors, with A a column-major 3x3
+// block given by its columns c0, c1, c2 (stride 4, as stored in Matrix4f)
+// and b a translation (ignored when w == 0).
+static void transformBatch( const float* c0, const float* c1, const float* c2, const float* b, float w,
+	const float* x, const float* y, const float* z,
+	float* outX, float* outY, float* outZ, int n, int stride )
+{
+	const float bx = w * b[ 0 ];
+	const float by = w * b[ 1 ];
+	const float bz = w * b[ 2 ];
+	int i = 0;
+
+#if defined( VECMATH_SSE )
+	if( stride == 1 )
+	{
+		for( ; i + 4 <= n; i += 4 )
+		{
+			__m128 vx = _mm_loadu_ps( x + i );
+			__m128 vy = _mm_loadu_ps( y + i );
+			__m128 vz = _mm_loadu_ps( z + i );
+			__m128 rx = _mm_add_ps( _mm_add_ps( _mm_add_ps( _mm_mul_ps( _mm_set1_ps( c0[ 0 ] ), vx ), _mm_mul_ps( _mm_set1_ps( c1[ 0 ] ), vy ) ), _mm_mul_ps( _mm_set1_ps( c2[ 0 ] ), vz ) ), _mm_set1_ps( bx ) );
+			__m128 ry = _mm_add_ps( _mm_add_ps( _mm_add_ps( _mm_mul_ps( _mm_set1_ps( c0[ 1 ] ), vx ), _mm_mul_ps( _mm_set1_ps( c1[ 1 ] ), vy ) ), _mm_mul_ps( _mm_set1_ps( c2[ 1 ] ), vz ) ), _mm_set1_ps( by ) );
+			__m128 rz = _mm_add_ps( _mm_add_ps( _mm_add_ps( _mm_mul_ps( _mm_set1_ps( c0[ 2 ] ), vx ), _mm_mul_ps( _mm_set1_ps( c1[ 2 ] ), vy ) ), _mm_mul_ps( _mm_set1_ps( c2[ 2 ] ), vz ) ), _mm_set1_ps( bz ) );
+			_mm_storeu_ps( outX + i, rx );
+			_mm_storeu_ps( outY + i, ry );
+			_mm_storeu_ps( outZ + i, rz );
+		}
+	}
+#elif defined( VECMATH_NEON )
+	if( stride == 1 )
 	{
-		for( int j = 0; j < 4; ++j )
+		for( ; i + 4 <= n; i += 4 )
 		{
-			out( j, i ) = ( *this )( i, j );
+			float32x4_t vx = vld1q_f32( x + i );
+			float32x4_t vy = vld1q_f32( y + i );
+			float32x4_t vz = vld1q_f32( z + i );
+			float32x4_t rx = vaddq_f32( vaddq_f32( vaddq_f32( vmulq_n_f32( vx, c0[ 0 ] ), vmulq_n_f32( vy, c1[ 0 ] ) ), vmulq_n_f32( vz, c2[ 0 ] ) ), vdupq_n_f32( bx ) );
+			float32x4_t ry = vaddq_f32( vaddq_f32( vaddq_f32( vmulq_n_f32( vx, c0[ 1 ] ), vmulq_n_f32( vy, c1[ 1 ] ) ), vmulq_n_f32( vz, c2[ 1 ] ) ), vdupq_n_f32( by ) );
+			float32x4_t rz = vaddq_f32( vaddq_f32( vaddq_f32( vmulq_n_f32( vx, c0[ 2 ] ), vmulq_n_f32( vy, c1[ 2 ] ) ), vmulq_n_f32( vz, c2[ 2 ] ) ), vdupq_n_f32( bz ) );
+			vst1q_f32( outX + i, rx );
+			vst1q_f32( outY + i, ry );
+			vst1q_f32( outZ + i, rz );
 		}
 	}
+#endif
 
-	return out;
+	for( ; i < n; ++i )
+	{
+		const int k = i * stride;
+		const float px = x[ k ];
+		const float py = y[ k ];
+		const float pz = z[ k ];
+		outX[ k ] = c0[ 0 ] * px + c1[ 0 ] * py + c2[ 0 ] * pz + bx;
+		outY[ k ] = c0[ 1 ] * px + c1[ 1 ] * py + c2[ 1 ] * pz + by;
+		outZ[ k ] = c0[ 2 ] * px + c1[ 2 ] * py + c2[ 2 ] * pz + bz;
+	}
 }
 
-Matrix4f::operator float* ()
+void Matrix4f::transformPoints( const float* x, const float* y, const float* z,
+	float* outX, float* outY, float* outZ, int n, int stride ) const
 {
-	return m_elements;
+	transformBatch( m_elements, m_elements + 4, m_elements + 8, m_elements + 12, 1,
+		x, y, z, outX, outY, outZ, n, stride );
 }
 
-Matrix4f::operator const float* ()const
+void Matrix4f::transformDirections( const float* x, const float* y, const float* z,
+	float* outX, float* outY, float* outZ, int n, int stride ) const
 {
-	return m_elements;
+	transformBatch( m_elements, m_elements + 4, m_elements + 8, m_elements + 12, 0,
+		x, y, z, outX, outY, outZ, n, stride );
 }
 
+void Matrix4f::transformNormals( const float* x, const float* y, const float* z,
+	float* outX, float* outY, float* outZ, int n, int stride ) const
+{
+	// columns of the inverse transpose are the rows of the inverse
+	Matrix3f inv = getSubmatrix3x3( 0, 0 ).inverse();
+	const float c[ 12 ] =
+	{
+		inv( 0, 0 ), inv( 0, 1 ), inv( 0, 2 ), 0,
+		inv( 1, 0 ), inv( 1, 1 ), inv( 1, 2 ), 0,
+		inv( 2, 0 ), inv( 2, 1 ), inv( 2, 2 ), 0
+	};
+	transformBatch( c, c + 4, c + 8, c, 0, x, y, z, outX, outY, outZ, n, stride );
+}
 
 void Matrix4f::print()
 {
@@ -356,19 +371,6 @@ Matrix4f Matrix4f::ones()
 	return m;
 }
 
-// static
-Matrix4f Matrix4f::identity()
-{
-	Matrix4f m;
-	
-	m( 0, 0 ) = 1;
-	m( 1, 1 ) = 1;
-	m( 2, 2 ) = 1;
-	m( 3, 3 ) = 1;
-
-	return m;
-}
-
 // static
 Matrix4f Matrix4f::translation( float x, float y, float z )
 {
@@ -672,64 +674,3 @@ Matrix4f Matrix4f::infinitePerspectiveProjection( float fLeft, float fRight,
 
 	return projection;
 }
-
-//////////////////////////////////////////////////////////////////////////
-// Operators
-//////////////////////////////////////////////////////////////////////////
-
-Vector4f operator * ( const Matrix4f& m, const Vector4f& v )
-{
-	Vector4f output( 0, 0, 0, 0 );
-
-	for( int i = 0; i < 4; ++i )
-	{
-		for( int j = 0; j < 4; ++j )
-		{
-			output[ i ] += m( i, j ) * v[ j ];
-		}
-	}
-
-	return output;
-}
-
-Matrix4f operator * ( const Matrix4f& x, const Matrix4f& y )
-{
-	Matrix4f product; // zeroes
-
-	for( int i = 0; i < 4; ++i )
-	{
-		for( int j = 0; j < 4; ++j )
-		{
-			for( int k = 0; k < 4; ++k )
-			{
-				product( i, k ) += x( i, j ) * y( j, k );
-			}
-		}
-	}
-
-	return product;
-}
-Matrix4f operator * (const Matrix4f& m, float f) {
-	Matrix4f product(m); // zeroes
-
-	for( int i = 0; i < 4; ++i )
-	{
-		for( int j = 0; j < 4; ++j )
-		{
-            product(i, j) *= f;
-		}
-	}
-	return product;
-}
-Matrix4f operator * (float f, const Matrix4f& m) {
-	Matrix4f product(m); // zeroes
-
-	for( int i = 0; i < 4; ++i )
-	{
-		for( int j = 0; j < 4; ++j )
-		{
-            product(i, j) *= f;
-		}
-	}
-	return product;
-}
@@ -0,0 +1,31 @@
+#ifndef VECMATH_SIMD_H
+#define VECMATH_SIMD_H
+
+// Optional SIMD backend for Vector4f and Matrix4f.
+//
+// Configure with -DVECMATH_SIMD=ON to build vecmath with VECMATH_SIMD
+// defined. The define is exported to everything that links vecmath, so
+// the library and its users always agree on the layout. With it,
+// Vector4f and Matrix4f become 16-byte aligned and their component-wise
+// operators, matrix-vector and matrix-matrix products use SSE on x86 or
+// NEON on ARM. Results are the same as the scalar code: each lane does
+// the same IEEE operations in the same order.
+//
+// Vector3f is left alone: it is 12 bytes and code relies on arrays of it
+// being tightly packed.
+
+#if defined( VECMATH_SIMD ) && ( defined( __SSE__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 1 ) )
+	#include <xmmintrin.h>
+	#define VECMATH_SSE 1
+#elif defined( VECMATH_SIMD ) && defined( __ARM_NEON )
+	#include <arm_neon.h>
+	#define VECMATH_NEON 1
+#endif
+
+#if defined( VECMATH_SSE ) || defined( VECMATH_NEON )
+	#define VECMATH_ALIGN alignas( 16 )
+#else
+	#define VECMATH_ALIGN
+#endif
+
+#endif // VECMATH_SIMD_H
@@ -1,8 +1,15 @@
 #ifndef VECTOR_3F_H
 #define VECTOR_3F_H
 
+#include <cmath>
+
 class Vector2f;
 
+// Everything that does not touch Vector2f is defined inline below, so the
+// hot arithmetic compiles down to straight-line code at the call site.
+// Vector3f stays a packed 12-byte POD: arrays of it are handed to OpenGL
+// and to the image code as raw floats.
+
 class Vector3f
 {
 public:
@@ -12,17 +19,17 @@ public:
 	static const Vector3f RIGHT;
 	static const Vector3f FORWARD;
 
-    explicit Vector3f( float f = 0.f );
-    Vector3f( float x, float y, float z );
+    constexpr explicit Vector3f( float f = 0.f ) : m_elements{ f, f, f } {}
+    constexpr Vector3f( float x, float y, float z ) : m_elements{ x, y, z } {}
 
 	Vector3f( const Vector2f& xy, float z );
 	Vector3f( float x, const Vector2f& yz );
 
 	// copy constructors
-    Vector3f( const Vector3f& rv );
+    Vector3f( const Vector3f& rv ) = default;
 
 	// assignment operators
-    Vector3f& operator = ( const Vector3f& rv );
+    Vector3f& operator = ( const Vector3f& rv ) = default;
 
 	// no destructor necessary
 
@@ -102,4 +109,210 @@ Vector3f operator / ( const Vector3f& v, float f );
 bool operator == ( const Vector3f& v0, const Vector3f& v1 );
 bool operator != ( const Vector3f& v0, const Vector3f& v1 );
 
+//////////////////////////////////////////////////////////////////////////
+// Inline definitions
+//////////////////////////////////////////////////////////////////////////
+
+inline const float& Vector3f::operator [] ( int i ) const
+{
+	return m_elements[ i ];
+}
+
+inline float& Vector3f::operator [] ( int i )
+{
+	return m_elements[ i ];
+}
+
+inline float& Vector3f::x()
+{
+	return m_elements[ 0 ];
+}
+
+inline float& Vector3f::y()
+{
+	return m_elements[ 1 ];
+}
+
+inline float& Vector3f::z()
+{
+	return m_elements[ 2 ];
+}
+
+inline float Vector3f::x() const
+{
+	return m_elements[ 0 ];
+}
+
+inline float Vector3f::y() const
+{
+	return m_elements[ 1 ];
+}
+
+inline float Vector3f::z() const
+{
+	return m_elements[ 2 ];
+}
+
+inline Vector3f Vector3f::xyz() const
+{
+	return Vector3f( m_elements[ 0 ], m_elements[ 1 ], m_elements[ 2 ] );
+}
+
+inline Vector3f Vector3f::yzx() const
+{
+	return Vector3f( m_elements[ 1 ], m_elements[ 2 ], m_elements[ 0 ] );
+}
+
+inline Vector3f Vector3f::zxy() const
+{
+	return Vector3f( m_elements[ 2 ], m_elements[ 0 ], m_elements[ 1 ] );
+}
+
+inline float Vector3f::abs() const
+{
+	return std::sqrt( absSquared() );
+}
+
+inline float Vector3f::absSquared() const
+{
+	return m_elements[ 0 ] * m_elements[ 0 ] + m_elements[ 1 ] * m_elements[ 1 ] + m_elements[ 2 ] * m_elements[ 2 ];
+}
+
+inline void Vector3f::normalize()
+{
+	float norm = abs();
+	m_elements[ 0 ] /= norm;
+	m_elements[ 1 ] /= norm;
+	m_elements[ 2 ] /= norm;
+}
+
+inline Vector3f Vector3f::normalized() const
+{
+	float norm = abs();
+	return Vector3f( m_elements[ 0 ] / norm, m_elements[ 1 ] / norm, m_elements[ 2 ] / norm );
+}
+
+inline void Vector3f::negate()
+{
+	m_elements[ 0 ] = -m_elements[ 0 ];
+	m_elements[ 1 ] = -m_elements[ 1 ];
+	m_elements[ 2 ] = -m_elements[ 2 ];
+}
+
+inline Vector3f::operator const float* () const
+{
+	return m_elements;
+}
+
+inline Vector3f::operator float* ()
+{
+	return m_elements;
+}
+
+inline Vector3f& Vector3f::operator += ( const Vector3f& v )
+{
+	m_elements[ 0 ] += v.m_elements[ 0 ];
+	m_elements[ 1 ] += v.m_elements[ 1 ];
+	m_elements[ 2 ] += v.m_elements[ 2 ];
+	return *this;
+}
+
+inline Vector3f& Vector3f::operator -= ( const Vector3f& v )
+{
+	m_elements[ 0 ] -= v.m_elements[ 0 ];
+	m_elements[ 1 ] -= v.m_elements[ 1 ];
+	m_elements[ 2 ] -= v.m_elements[ 2 ];
+	return *this;
+}
+
+inline Vector3f& Vector3f::operator *= ( float f )
+{
+	m_elements[ 0 ] *= f;
+	m_elements[ 1 ] *= f;
+	m_elements[ 2 ] *= f;
+	return *this;
+}
+
+inline Vector3f& Vector3f::operator /= ( float f )
+{
+	m_elements[ 0 ] /= f;
+	m_elements[ 1 ] /= f;
+	m_elements[ 2 ] /= f;
+	return *this;
+}
+
+// static
+inline float Vector3f::dot( const Vector3f& v0, const Vector3f& v1 )
+{
+	return v0[ 0 ] * v1[ 0 ] + v0[ 1 ] * v1[ 1 ] + v0[ 2 ] * v1[ 2 ];
+}
+
+// static
+inline Vector3f Vector3f::cross( const Vector3f& v0, const Vector3f& v1 )
+{
+	return Vector3f
+		(
+			v0.y() * v1.z() - v0.z() * v1.y(),
+			v0.z() * v1.x() - v0.x() * v1.z(),
+			v0.x() * v1.y() - v0.y() * v1.x()
+		);
+}
+
+inline Vector3f operator + ( const Vector3f& v0, const Vector3f& v1 )
+{
+	return Vector3f( v0[ 0 ] + v1[ 0 ], v0[ 1 ] + v1[ 1 ], v0[ 2 ] + v1[ 2 ] );
+}
+
+inline Vector3f operator - ( const Vector3f& v0, const Vector3f& v1 )
+{
+	return Vector3f( v0[ 0 ] - v1[ 0 ], v0[ 1 ] - v1[ 1 ], v0[ 2 ] - v1[ 2 ] );
+}
+
+inline Vector3f operator * ( const Vector3f& v0, const Vector3f& v1 )
+{
+	return Vector3f( v0[ 0 ] * v1[ 0 ], v0[ 1 ] * v1[ 1 ], v0[ 2 ] * v1[ 2 ] );
+}
+
+inline Vector3f operator / ( const Vector3f& v0, const Vector3f& v1 )
+{
+	return Vector3f( v0[ 0 ] / v1[ 0 ], v0[ 1 ] / v1[ 1 ], v0[ 2 ] / v1[ 2 ] );
+}
+
+inline Vector3f operator - ( const Vector3f& v )
+{
+	return Vector3f( -v[ 0 ], -v[ 1 ], -v[ 2 ] );
+}
+
+inline Vector3f operator * ( float f, const Vector3f& v )
+{
+	return Vector3f( v[ 0 ] * f, v[ 1 ] * f, v[ 2 ] * f );
+}
+
+inline Vector3f operator * ( const Vector3f& v, float f )
+{
+	return Vector3f( v[ 0 ] * f, v[ 1 ] * f, v[ 2 ] * f );
+}
+
+inline Vector3f operator / ( const Vector3f& v, float f )
+{
+	return Vector3f( v[ 0 ] / f, v[ 1 ] / f, v[ 2 ] / f );
+}
+
+// static
+// 线性插值
+inline Vector3f Vector3f::lerp( const Vector3f& v0, const Vector3f& v1, float alpha )
+{
+	return alpha * ( v1 - v0 ) + v0;
+}
+
+inline bool operator == ( const Vector3f& v0, const Vector3f& v1 )
+{
+	return( v0.x() == v1.x() && v0.y() == v1.y() && v0.z() == v1.z() );
+}
+
+inline bool operator != ( const Vector3f& v0, const Vector3f& v1 )
+{
+	return !( v0 == v1 );
+}
+
 #endif // VECTOR_3F_H
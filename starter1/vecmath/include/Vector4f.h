@@ -1,15 +1,23 @@
 #ifndef VECTOR_4F_H
 #define VECTOR_4F_H
 
+#include <cmath>
+
+#include "Vector3f.h"
+#include "VecmathSIMD.h"
+
 class Vector2f;
-class Vector3f;
+
+// Everything that does not touch Vector2f is defined inline below. With
+// VECMATH_SIMD, storage is 16-byte aligned and the component-wise
+// operators map to single SSE / NEON instructions (see VecmathSIMD.h).
 
 class Vector4f
 {
 public:
 
-	explicit Vector4f( float f = 0.f );
-	Vector4f( float fx, float fy, float fz, float fw );
+	constexpr explicit Vector4f( float f = 0.f ) : m_elements{ f, f, f, f } {}
+	constexpr Vector4f( float fx, float fy, float fz, float fw ) : m_elements{ fx, fy, fz, fw } {}
 	Vector4f( float buffer[ 4 ] );
 
 	Vector4f( const Vector2f& xy, float z, float w );
@@ -21,10 +29,10 @@ public:
 	Vector4f( float x, const Vector3f& yzw );
 
 	// copy constructors
-	Vector4f( const Vector4f& rv );
+	Vector4f( const Vector4f& rv ) = default;
 
 	// assignment operators
-	Vector4f& operator = ( const Vector4f& rv );
+	Vector4f& operator = ( const Vector4f& rv ) = default;
 
 	// no destructor necessary
 
@@ -78,7 +86,7 @@ public:
 
 private:
 
-	float m_elements[ 4 ];
+	VECMATH_ALIGN float m_elements[ 4 ];
 
 };
 
@@ -99,4 +107,339 @@ Vector4f operator / ( const Vector4f& v, float f );
 bool operator == ( const Vector4f& v0, const Vector4f& v1 );
 bool operator != ( const Vector4f& v0, const Vector4f& v1 );
 
+//////////////////////////////////////////////////////////////////////////
+// Inline definitions
+//////////////////////////////////////////////////////////////////////////
+
+inline Vector4f::Vector4f( float buffer[ 4 ] ) :
+	m_elements{ buffer[ 0 ], buffer[ 1 ], buffer[ 2 ], buffer[ 3 ] }
+{
+}
+
+inline Vector4f::Vector4f( const Vector3f& xyz, float w ) :
+	m_elements{ xyz.x(), xyz.y(), xyz.z(), w }
+{
+}
+
+inline Vector4f::Vector4f( float x, const Vector3f& yzw ) :
+	m_elements{ x, yzw.x(), yzw.y(), yzw.z() }
+{
+}
+
+inline const float& Vector4f::operator [] ( int i ) const
+{
+	return m_elements[ i ];
+}
+
+inline float& Vector4f::operator [] ( int i )
+{
+	return m_elements[ i ];
+}
+
+inline float& Vector4f::x()
+{
+	return m_elements[ 0 ];
+}
+
+inline float& Vector4f::y()
+{
+	return m_elements[ 1 ];
+}
+
+inline float& Vector4f::z()
+{
+	return m_elements[ 2 ];
+}
+
+inline float& Vector4f::w()
+{
+	return m_elements[ 3 ];
+}
+
+inline float Vector4f::x() const
+{
+	return m_elements[ 0 ];
+}
+
+inline float Vector4f::y() const
+{
+	return m_elements[ 1 ];
+}
+
+inline float Vector4f::z() const
+{
+	return m_elements[ 2 ];
+}
+
+inline float Vector4f::w() const
+{
+	return m_elements[ 3 ];
+}
+
+inline Vector3f Vector4f::xyz() const
+{
+	return Vector3f( m_elements[ 0 ], m_elements[ 1 ], m_elements[ 2 ] );
+}
+
+inline Vector3f Vector4f::yzw() const
+{
+	return Vector3f( m_elements[ 1 ], m_elements[ 2 ], m_elements[ 3 ] );
+}
+
+inline Vector3f Vector4f::zwx() const
+{
+	return Vector3f( m_elements[ 2 ], m_elements[ 3 ], m_elements[ 0 ] );
+}
+
+inline Vector3f Vector4f::wxy() const
+{
+	return Vector3f( m_elements[ 3 ], m_elements[ 0 ], m_elements[ 1 ] );
+}
+
+inline Vector3f Vector4f::xyw() const
+{
+	return Vector3f( m_elements[ 0 ], m_elements[ 1 ], m_elements[ 3 ] );
+}
+
+inline Vector3f Vector4f::yzx() const
+{
+	return Vector3f( m_elements[ 1 ], m_elements[ 2 ], m_elements[ 0 ] );
+}
+
+inline Vector3f Vector4f::zwy() const
+{
+	return Vector3f( m_elements[ 2 ], m_elements[ 3 ], m_elements[ 1 ] );
+}
+
+inline Vector3f Vector4f::wxz() const
+{
+	return Vector3f( m_elements[ 3 ], m_elements[ 0 ], m_elements[ 2 ] );
+}
+
+inline float Vector4f::abs() const
+{
+	return std::sqrt( absSquared() );
+}
+
+inline float Vector4f::absSquared() const
+{
+	return( m_elements[ 0 ] * m_elements[ 0 ] + m_elements[ 1 ] * m_elements[ 1 ] + m_elements[ 2 ] * m_elements[ 2 ] + m_elements[ 3 ] * m_elements[ 3 ] );
+}
+
+inline void Vector4f::normalize()
+{
+	float norm = abs();
+	m_elements[ 0 ] = m_elements[ 0 ] / norm;
+	m_elements[ 1 ] = m_elements[ 1 ] / norm;
+	m_elements[ 2 ] = m_elements[ 2 ] / norm;
+	m_elements[ 3 ] = m_elements[ 3 ] / norm;
+}
+
+inline Vector4f Vector4f::normalized() const
+{
+	float length = abs();
+	return Vector4f
+		(
+			m_elements[ 0 ] / length,
+			m_elements[ 1 ] / length,
+			m_elements[ 2 ] / length,
+			m_elements[ 3 ] / length
+		);
+}
+
+inline void Vector4f::homogenize()
+{
+	if( m_elements[ 3 ] != 0 )
+	{
+		m_elements[ 0 ] /= m_elements[ 3 ];
+		m_elements[ 1 ] /= m_elements[ 3 ];
+		m_elements[ 2 ] /= m_elements[ 3 ];
+		m_elements[ 3 ] = 1;
+	}
+}
+
+inline Vector4f Vector4f::homogenized() const
+{
+	if( m_elements[ 3 ] != 0 )
+	{
+		return Vector4f
+			(
+				m_elements[ 0 ] / m_elements[ 3 ],
+				m_elements[ 1 ] / m_elements[ 3 ],
+				m_elements[ 2 ] / m_elements[ 3 ],
+				1
+			);
+	}
+	return *this;
+}
+
+inline void Vector4f::negate()
+{
+	m_elements[ 0 ] = -m_elements[ 0 ];
+	m_elements[ 1 ] = -m_elements[ 1 ];
+	m_elements[ 2 ] = -m_elements[ 2 ];
+	m_elements[ 3 ] = -m_elements[ 3 ];
+}
+
+inline Vector4f::operator const float* () const
+{
+	return m_elements;
+}
+
+inline Vector4f::operator float* ()
+{
+	return m_elements;
+}
+
+// static
+inline float Vector4f::dot( const Vector4f& v0, const Vector4f& v1 )
+{
+	return v0.x() * v1.x() + v0.y() * v1.y() + v0.z() * v1.z() + v0.w() * v1.w();
+}
+
+#if defined( VECMATH_SSE )
+
+inline Vector4f operator + ( const Vector4f& v0, const Vector4f& v1 )
+{
+	Vector4f out;
+	_mm_store_ps( out, _mm_add_ps( _mm_load_ps( v0 ), _mm_load_ps( v1 ) ) );
+	return out;
+}
+
+inline Vector4f operator - ( const Vector4f& v0, const Vector4f& v1 )
+{
+	Vector4f out;
+	_mm_store_ps( out, _mm_sub_ps( _mm_load_ps( v0 ), _mm_load_ps( v1 ) ) );
+	return out;
+}
+
+inline Vector4f operator * ( const Vector4f& v0, const Vector4f& v1 )
+{
+	Vector4f out;
+	_mm_store_ps( out, _mm_mul_ps( _mm_load_ps( v0 ), _mm_load_ps( v1 ) ) );
+	return out;
+}
+
+inline Vector4f operator / ( const Vector4f& v0, const Vector4f& v1 )
+{
+	Vector4f out;
+	_mm_store_ps( out, _mm_div_ps( _mm_load_ps( v0 ), _mm_load_ps( v1 ) ) );
+	return out;
+}
+
+inline Vector4f operator * ( float f, const Vector4f& v )
+{
+	Vector4f out;
+	_mm_store_ps( out, _mm_mul_ps( _mm_set1_ps( f ), _mm_load_ps( v ) ) );
+	return out;
+}
+
+inline Vector4f operator / ( const Vector4f& v, float f )
+{
+	Vector4f out;
+	_mm_store_ps( out, _mm_div_ps( _mm_load_ps( v ), _mm_set1_ps( f ) ) );
+	return out;
+}
+
+#elif defined( VECMATH_NEON )
+
+inline Vector4f operator + ( const Vector4f& v0, const Vector4f& v1 )
+{
+	Vector4f out;
+	vst1q_f32( out, vaddq_f32( vld1q_f32( v0 ), vld1q_f32( v1 ) ) );
+	return out;
+}
+
+inline Vector4f operator - ( const Vector4f& v0, const Vector4f& v1 )
+{
+	Vector4f out;
+	vst1q_f32( out, vsubq_f32( vld1q_f32( v0 ), vld1q_f32( v1 ) ) );
+	return out;
+}
+
+inline Vector4f operator * ( const Vector4f& v0, const Vector4f& v1 )
+{
+	Vector4f out;
+	vst1q_f32( out, vmulq_f32( vld1q_f32( v0 ), vld1q_f32( v1 ) ) );
+	return out;
+}
+
+// 32-bit NEON has no vector divide
+inline Vector4f operator / ( const Vector4f& v0, const Vector4f& v1 )
+{
+	return Vector4f( v0.x() / v1.x(), v0.y() / v1.y(), v0.z() / v1.z(), v0.w() / v1.w() );
+}
+
+inline Vector4f operator * ( float f, const Vector4f& v )
+{
+	Vector4f out;
+	vst1q_f32( out, vmulq_n_f32( vld1q_f32( v ), f ) );
+	return out;
+}
+
+inline Vector4f operator / ( const Vector4f& v, float f )
+{
+	return Vector4f( v[ 0 ] / f, v[ 1 ] / f, v[ 2 ] / f, v[ 3 ] / f );
+}
+
+#else
+
+inline Vector4f operator + ( const Vector4f& v0, const Vector4f& v1 )
+{
+	return Vector4f( v0.x() + v1.x(), v0.y() + v1.y(), v0.z() + v1.z(), v0.w() + v1.w() );
+}
+
+inline Vector4f operator - ( const Vector4f& v0, const Vector4f& v1 )
+{
+	return Vector4f( v0.x() - v1.x(), v0.y() - v1.y(), v0.z() - v1.z(), v0.w() - v1.w() );
+}
+
+inline Vector4f operator * ( const Vector4f& v0, const Vector4f& v1 )
+{
+	return Vector4f( v0.x() * v1.x(), v0.y() * v1.y(), v0.z() * v1.z(), v0.w() * v1.w() );
+}
+
+inline Vector4f operator / ( const Vector4f& v0, const Vector4f& v1 )
+{
+	return Vector4f( v0.x() / v1.x(), v0.y() / v1.y(), v0.z() / v1.z(), v0.w() / v1.w() );
+}
+
+inline Vector4f operator * ( float f, const Vector4f& v )
+{
+	return Vector4f( f * v.x(), f * v.y(), f * v.z(), f * v.w() );
+}
+
+inline Vector4f operator / ( const Vector4f& v, float f )
+{
+	return Vector4f( v[ 0 ] / f, v[ 1 ] / f, v[ 2 ] / f, v[ 3 ] / f );
+}
+
+#endif
+
+inline Vector4f operator - ( const Vector4f& v )
+{
+	return Vector4f( -v.x(), -v.y(), -v.z(), -v.w() );
+}
+
+inline Vector4f operator * ( const Vector4f& v, float f )
+{
+	return f * v;
+}
+
+// static
+inline Vector4f Vector4f::lerp( const Vector4f& v0, const Vector4f& v1, float alpha )
+{
+	return alpha * ( v1 - v0 ) + v0;
+}
+
+inline bool operator == ( const Vector4f& v0, const Vector4f& v1 )
+{
+	return( v0.x() == v1.x() && v0.y() == v1.y() && v0.z() == v1.z() && v0.w() == v1.w() );
+}
+
+inline bool operator != ( const Vector4f& v0, const Vector4f& v1 )
+{
+	return !( v0 == v1 );
+}
+
 #endif // VECTOR_4F_H
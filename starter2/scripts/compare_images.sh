@@ -0,0 +1,15 @@
+#!/bin/sh
+# Compares the images generate_images.sh writes to out/basics with the
+# references in sample_out. Exits with 1 if any of them falls below the
+# thresholds.
+
+BIN=${BIN:-build/a2}
+MIN_PSNR=${MIN_PSNR:-30}
+MIN_SSIM=${MIN_SSIM:-0.99}
+
+fail=0
+for ref in sample_out/*.png; do
+    name=$(basename ${ref})
+    ${BIN} -compare out/basics/${name} ${ref} -min_psnr ${MIN_PSNR} -min_ssim ${MIN_SSIM} || fail=1
+done
+exit ${fail}
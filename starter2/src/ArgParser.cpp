@@ -1,4 +1,7 @@
 #include "ArgParser.h"
+#include "Filter.h"
+#include "PixelOrder.h"
+#include "RenderStats.h"
 
 #include <cstring>
 #include <cassert>
@@ -21,13 +24,69 @@ ArgParser::ArgParser(int argc, const char *argv[])
         } else if (!strcmp(argv[i], "-normals")) {
             i++; assert (i < argc); 
             normals_file = argv[i];
+        } else if (!strcmp(argv[i], "-objectid")) {
+            i++; assert (i < argc); 
+            objectid_file = argv[i];
+        } else if (!strcmp(argv[i], "-materialid")) {
+            i++; assert (i < argc); 
+            materialid_file = argv[i];
+        } else if (!strcmp(argv[i], "-hitcount")) {
+            i++; assert (i < argc); 
+            hitcount_file = argv[i];
+        } else if (!strcmp(argv[i], "-cost")) {
+            i++; assert (i < argc); 
+            cost_metric = argv[i];
+            i++; assert (i < argc); 
+            cost_file = argv[i];
+            RenderStats::Cost cost;
+            if (!RenderStats::parseCost(cost_metric, cost)) {
+                printf ("Unknown cost measure: '%s'\n", cost_metric.c_str());
+                exit(1);
+            }
+        } else if (!strcmp(argv[i], "-layers")) {
+            i++; assert (i < argc); 
+            layers_file = argv[i];
+        } else if (!strcmp(argv[i], "-layers_half")) {
+            layers_half = true;
         } else if (!strcmp(argv[i], "-size")) {
             i++; assert (i < argc); 
             width = atoi(argv[i]);
             i++; assert (i < argc); 
             height = atoi(argv[i]);
+        } else if (!strcmp(argv[i], "-png_compression")) {
+            i++; assert (i < argc); 
+            png_compression = atoi(argv[i]);
+            if (png_compression < 1) {
+                printf ("Invalid PNG compression level: '%s'\n", argv[i]);
+                exit(1);
+            }
+        } else if (!strcmp(argv[i], "-stats")) {
+            stats = 1;
+        } else if (!strcmp(argv[i], "-stats_json")) {
+            i++; assert (i < argc); 
+            stats_file = argv[i];
         } 
 
+        // image comparison
+        else if (!strcmp(argv[i], "-compare")) {
+            i++; assert (i < argc); 
+            compare_file = argv[i];
+            i++; assert (i < argc); 
+            reference_file = argv[i];
+        } else if (!strcmp(argv[i], "-diff")) {
+            i++; assert (i < argc); 
+            diff_file = argv[i];
+        } else if (!strcmp(argv[i], "-max_error")) {
+            i++; assert (i < argc); 
+            max_error = (float)atof(argv[i]);
+        } else if (!strcmp(argv[i], "-min_psnr")) {
+            i++; assert (i < argc); 
+            min_psnr = (float)atof(argv[i]);
+        } else if (!strcmp(argv[i], "-min_ssim")) {
+            i++; assert (i < argc); 
+            min_ssim = (float)atof(argv[i]);
+        }
+
         // rendering options
         else if (!strcmp(argv[i], "-depth")) {
             i++; assert (i < argc); 
@@ -39,33 +98,201 @@ ArgParser::ArgParser(int argc, const char *argv[])
         } else if (!strcmp(argv[i], "-bounces")) {
             i++; assert (i < argc); 
             bounces = atoi(argv[i]);
+        } else if (!strcmp(argv[i], "-rr_threshold")) {
+            i++; assert (i < argc); 
+            rr_threshold = (float)atof(argv[i]);
         } else if (!strcmp(argv[i], "-shadows")) {
             shadows = true;
+        } else if (!strcmp(argv[i], "-light_cutoff")) {
+            i++; assert (i < argc); 
+            light_cutoff = (float)atof(argv[i]);
+        } else if (!strcmp(argv[i], "-light_pick")) {
+            light_pick = true;
         }
 
         // supersampling
         else if (strcmp(argv[i], "-jitter") == 0) {
             jitter = true;
+        } else if (!strcmp(argv[i], "-samples")) {
+            i++; assert (i < argc); 
+            samples = atoi(argv[i]);
+            if (samples < 1) {
+                printf ("Invalid sample count: '%s'\n", argv[i]);
+                exit(1);
+            }
         } else if(strcmp(argv[i], "-filter") == 0) {
             filter = true;
+        } else if (!strcmp(argv[i], "-supersample")) {
+            i++; assert (i < argc); 
+            supersample = atoi(argv[i]);
+            filter = true;
+            if (supersample < 1) {
+                printf ("Invalid supersampling factor: '%s'\n", argv[i]);
+                exit(1);
+            }
+        } else if (!strcmp(argv[i], "-kernel")) {
+            i++; assert (i < argc); 
+            filter_kernel = argv[i];
+            filter = true;
+            Filter::Type type;
+            if (!Filter::parseType(filter_kernel, type)) {
+                printf ("Unknown filter kernel: '%s'\n", argv[i]);
+                exit(1);
+            }
+        } else if (!strcmp(argv[i], "-filter_radius")) {
+            i++; assert (i < argc); 
+            filter_radius = (float)atof(argv[i]);
+            if (filter_radius <= 0) {
+                printf ("Invalid filter radius: '%s'\n", argv[i]);
+                exit(1);
+            }
         } 
+
+        // path tracing
+        else if (!strcmp(argv[i], "-path_trace")) {
+            path_trace = true;
+        } else if (!strcmp(argv[i], "-progressive")) {
+            progressive = true;
+        } else if (!strcmp(argv[i], "-irradiance_cache")) {
+            irradiance_cache = true;
+        } else if (!strcmp(argv[i], "-ic_error")) {
+            i++; assert (i < argc); 
+            ic_error = (float)atof(argv[i]);
+            if (ic_error <= 0) {
+                printf ("Invalid irradiance cache error: '%s'\n", argv[i]);
+                exit(1);
+            }
+        } else if (!strcmp(argv[i], "-ic_samples")) {
+            i++; assert (i < argc); 
+            ic_samples = atoi(argv[i]);
+            if (ic_samples < 6) {
+                printf ("Invalid irradiance cache sample count: '%s'\n", argv[i]);
+                exit(1);
+            }
+        }
+
+        // textures
+        else if (!strcmp(argv[i], "-texture_cache")) {
+            i++; assert (i < argc); 
+            texture_cache = atoi(argv[i]);
+            if (texture_cache < 1) {
+                printf ("Invalid texture cache size: '%s'\n", argv[i]);
+                exit(1);
+            }
+        } else if (!strcmp(argv[i], "-texture_cache_dir")) {
+            i++; assert (i < argc); 
+            texture_cache_dir = argv[i];
+        }
+
+        // wavefront tracing
+        else if (!strcmp(argv[i], "-wavefront")) {
+            wavefront = true;
+        } else if (!strcmp(argv[i], "-tile_size")) {
+            i++; assert (i < argc); 
+            tile_size = atoi(argv[i]);
+            if (tile_size < 1) {
+                printf ("Invalid tile size: '%s'\n", argv[i]);
+                exit(1);
+            }
+        } else if (!strcmp(argv[i], "-threads")) {
+            i++; assert (i < argc); 
+            threads = atoi(argv[i]);
+            if (threads < 0) {
+                printf ("Invalid thread count: '%s'\n", argv[i]);
+                exit(1);
+            }
+        } else if (!strcmp(argv[i], "-pixel_order")) {
+            i++; assert (i < argc); 
+            pixel_order = argv[i];
+            PixelOrder::Type type;
+            if (!PixelOrder::parseType(pixel_order, type)) {
+                printf ("Unknown pixel order: '%s'\n", argv[i]);
+                exit(1);
+            }
+        } else if (!strcmp(argv[i], "-sort_rays")) {
+            sort_rays = true;
+        } else if (!strcmp(argv[i], "-bench_sort")) {
+            bench_sort = true;
+        }
+
+        // post-processing
+        else if (!strcmp(argv[i], "-denoise")) {
+            denoise = true;
+        }
         else {
             printf ("Unknown command line argument %d: '%s'\n", i, argv[i]);
             exit(1);
         }
     }
 
+    // a comparison run renders nothing, so skip the render settings
+    if (compare_file.size()) {
+        return;
+    }
+
     std::cout << "Args:\n";
     std::cout << "- input: " << input_file << std::endl;
     std::cout << "- output: " << output_file << std::endl;
     std::cout << "- depth_file: " << depth_file << std::endl;
     std::cout << "- normals_file: " << normals_file << std::endl;
+    if (objectid_file.size()) {
+        std::cout << "- objectid_file: " << objectid_file << std::endl;
+    }
+    if (materialid_file.size()) {
+        std::cout << "- materialid_file: " << materialid_file << std::endl;
+    }
+    if (hitcount_file.size()) {
+        std::cout << "- hitcount_file: " << hitcount_file << std::endl;
+    }
+    if (cost_file.size()) {
+        std::cout << "- cost_file: " << cost_file << " (" << cost_metric << ")" << std::endl;
+    }
+    if (layers_file.size()) {
+        std::cout << "- layers_file: " << layers_file << (layers_half ? " (half)" : "") << std::endl;
+    }
     std::cout << "- width: " << width << std::endl;
     std::cout << "- height: " << height << std::endl;
+    if (png_compression != 8) {
+        std::cout << "- png_compression: " << png_compression << std::endl;
+    }
+    if (stats || stats_file.size()) {
+        std::cout << "- stats: " << stats << (stats_file.size() ? ", json " + stats_file : "") << std::endl;
+    }
     std::cout << "- depth_min: " << depth_min << std::endl;
     std::cout << "- depth_max: " << depth_max << std::endl;
     std::cout << "- bounces: " << bounces << std::endl;
     std::cout << "- shadows: " << shadows << std::endl;
+    if (light_cutoff > 0) {
+        std::cout << "- light_cutoff: " << light_cutoff << std::endl;
+    }
+    if (light_pick) {
+        std::cout << "- light_pick: " << light_pick << std::endl;
+    }
+    if (jitter || path_trace) {
+        std::cout << "- samples: " << samples << std::endl;
+    }
+    if (filter) {
+        std::cout << "- filter: " << filter_kernel << " x" << supersample << std::endl;
+    }
+    if (pixel_order != "scanline") {
+        std::cout << "- pixel_order: " << pixel_order << std::endl;
+    }
+    if (path_trace) {
+        std::cout << "- path_trace: tile " << tile_size
+                  << (progressive ? ", progressive" : "") << std::endl;
+    }
+    if (path_trace && irradiance_cache) {
+        std::cout << "- irradiance_cache: error " << ic_error
+                  << ", " << ic_samples << " samples" << std::endl;
+    }
+    std::cout << "- texture_cache: " << texture_cache << " MB" << std::endl;
+    if (texture_cache_dir.size()) {
+        std::cout << "- texture_cache_dir: " << texture_cache_dir << std::endl;
+    }
+    if (wavefront) {
+        std::cout << "- wavefront: tile " << tile_size << std::endl;
+    }
+    std::cout << "- denoise: " << denoise << std::endl;
 }
 
 void
@@ -76,17 +303,62 @@ ArgParser::defaultValues()
     output_file = "";
     depth_file = "";
     normals_file = "";
+    objectid_file = "";
+    materialid_file = "";
+    hitcount_file = "";
+    cost_file = "";
+    cost_metric = "nodes";
+    layers_file = "";
+    layers_half = false;
     width = 100;
     height = 100;
+    png_compression = 8;
     stats = 0;
+    stats_file = "";
+
+    // image comparison
+    compare_file = "";
+    reference_file = "";
+    diff_file = "";
+    max_error = -1;
+    min_psnr = -1;
+    min_ssim = -1;
 
     // rendering options
     depth_min = 0;
     depth_max = 1;
     bounces = 0;
     shadows = false;
+    rr_threshold = 1.0f / 256.0f;
+    light_cutoff = 0;
+    light_pick = false;
 
     // sampling
     jitter = false;
+    samples = 16;
     filter = false;
+    supersample = 3;
+    filter_kernel = "binomial";
+    filter_radius = 0;
+
+    // path tracing
+    path_trace = false;
+    progressive = false;
+    irradiance_cache = false;
+    ic_error = 0.2f;
+    ic_samples = 256;
+
+    // textures
+    texture_cache = 256;
+
+    // wavefront tracing
+    wavefront = false;
+    tile_size = 32;
+    threads = 0;
+    pixel_order = "scanline";
+    sort_rays = false;
+    bench_sort = false;
+
+    // post-processing
+    denoise = false;
 }
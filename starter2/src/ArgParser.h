@@ -16,19 +16,65 @@ public:
     std::string output_file;
     std::string depth_file;
     std::string normals_file;
+    std::string objectid_file;
+    std::string materialid_file;
+    std::string hitcount_file;
+    std::string cost_file;
+    std::string cost_metric;
+    std::string layers_file;
+    bool layers_half;
     int width;
     int height;
+    int png_compression;
     int stats;
+    std::string stats_file;
+
+    // image comparison (no rendering)
+    std::string compare_file;
+    std::string reference_file;
+    std::string diff_file;
+    float max_error;
+    float min_psnr;
+    float min_ssim;
 
     // rendering options
     float depth_min;
     float depth_max;
     int bounces;
     bool shadows;
+    float rr_threshold;
+    float light_cutoff;
+    bool light_pick;
 
     // supersampling
     bool jitter;
+    int samples;
     bool filter;
+    int supersample;
+    std::string filter_kernel;
+    float filter_radius;
+
+    // path tracing
+    bool path_trace;
+    bool progressive;
+    bool irradiance_cache;
+    float ic_error;
+    int ic_samples;
+
+    // textures
+    int texture_cache;
+    std::string texture_cache_dir;
+
+    // wavefront tracing
+    bool wavefront;
+    int tile_size;
+    int threads;
+    std::string pixel_order;
+    bool sort_rays;
+    bool bench_sort;
+
+    // post-processing
+    bool denoise;
 
 private:
     void defaultValues();
@@ -31,13 +31,16 @@ public:
         _angle(angleradians)
     {
         _horizontal = Vector3f::cross(direction, up).normalized();
+        // the image plane sits at distance d along the view direction;
+        // this part of the ray direction is the same for every pixel
+        float d = 1.0f / (float)std::tan(_angle / 2.0f);
+        _forward = d * _direction;
     }
 
     virtual Ray generateRay(const Vector2f &point) override
     {
         // BEGIN STARTER
-        float d = 1.0f / (float)std::tan(_angle / 2.0f);
-        Vector3f newDir = d * _direction + point[0] * _horizontal + point[1] * _up;
+        Vector3f newDir = _forward + point[0] * _horizontal + point[1] * _up;
         newDir = newDir.normalized();
 
         return Ray(_center, newDir);
@@ -55,6 +58,7 @@ private:
     Vector3f _up;
     float _angle;
     Vector3f _horizontal;
+    Vector3f _forward; // d * _direction
 };
 
 #endif //CAMERA_H
@@ -1,38 +1,446 @@
 #include "CubeMap.h"
+#include "Half.h"
+#include "Parallel.h"
 
+#include "stb_image.h"
+
+#include <VecmathSIMD.h>
+
+#include <sys/stat.h>
+
+#include <algorithm>
 #include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <string>
 #include <iostream>
 
-CubeMap::CubeMap(const std::string &directory)
+#if defined(__unix__) || defined(__APPLE__)
+#define CUBEMAP_PREAD
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+static const char *sideNames[6] = { "left", "right", "up", "down", "front", "back" };
+
+// Layout of a .texcache file: this header, then each level's tiles at its
+// offset (16-byte aligned). Tiles are 64x64 texels, stored row by row,
+// top to bottom as in the PNG; tiles on the right and bottom edges, and
+// the single tile of levels under 64 texels, are padded to full size.
+// Level 0 holds 8-bit RGB texels, the other levels half-float RGB.
+static const char cacheMagic[8] = { 'C', 'U', 'B', 'E', 'M', 'I', 'P', 0 };
+static const uint32_t cacheVersion = 2;
+static const int maxLevels = 32;
+static const int tileShift = 6;
+static const int tileSize = 1 << tileShift;
+
+struct CacheHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t levels;
+    // the PNG the texels were decoded from
+    uint64_t sourceSize;
+    int64_t sourceTime;
+    uint32_t width[maxLevels];
+    uint32_t height[maxLevels];
+    uint32_t tileWidth[maxLevels];
+    uint32_t tileHeight[maxLevels];
+    uint64_t offset[maxLevels];
+};
+
+static size_t
+alignUp(size_t n)
+{
+    return (n + 15) & ~(size_t)15;
+}
+
+static size_t
+tileBytes(uint32_t tileWidth, uint32_t tileHeight, uint32_t level)
+{
+    return (size_t)tileWidth * tileHeight * (level == 0 ? 3 : 6);
+}
+
+static size_t
+levelBytes(const CacheHeader &header, uint32_t level)
+{
+    const size_t tilesX = (header.width[level] + header.tileWidth[level] - 1) / header.tileWidth[level];
+    const size_t tilesY = (header.height[level] + header.tileHeight[level] - 1) / header.tileHeight[level];
+    return tilesX * tilesY * tileBytes(header.tileWidth[level], header.tileHeight[level], level);
+}
+
+static bool
+sourceStamp(const std::string &filename, uint64_t &size, int64_t &time)
+{
+    struct stat st;
+    if (stat(filename.c_str(), &st) != 0) {
+        return false;
+    }
+    size = (uint64_t)st.st_size;
+    time = (int64_t)st.st_mtime;
+    return true;
+}
+
+// 2x2 box filter of an RGB float image, halving each side (odd sides
+// round down, at least 1).
+static std::vector<float>
+downsample(const std::vector<float> &image, int w, int h, int &rw, int &rh)
+{
+    rw = std::max(1, w / 2);
+    rh = std::max(1, h / 2);
+    std::vector<float> result(3 * (size_t)rw * rh);
+    for (int y = 0; y < rh; ++y) {
+        const float *row0 = &image[3 * (size_t)std::min(2 * y, h - 1) * w];
+        const float *row1 = &image[3 * (size_t)std::min(2 * y + 1, h - 1) * w];
+        for (int x = 0; x < rw; ++x) {
+            int x0 = 3 * std::min(2 * x, w - 1);
+            int x1 = 3 * std::min(2 * x + 1, w - 1);
+            for (int c = 0; c < 3; ++c) {
+                result[3 * ((size_t)y * rw + x) + c] =
+                    0.25f * (row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c]);
+            }
+        }
+    }
+    return result;
+}
+
+// Where texel (x, y) of a level goes in the cache file.
+static size_t
+tiledOffset(const CacheHeader &header, uint32_t level, int x, int y)
+{
+    const int tw = (int)header.tileWidth[level];
+    const int th = (int)header.tileHeight[level];
+    const size_t tilesX = (header.width[level] + tw - 1) / tw;
+    const size_t t = (y / th) * tilesX + x / tw;
+    return header.offset[level] + t * tileBytes(tw, th, level) +
+        ((size_t)(y % th) * tw + x % tw) * (level == 0 ? 3 : 6);
+}
+
+std::string CubeMap::_cacheDirectory;
+
+CubeMap::CubeMap(const std::string &directory) :
+    _directory(directory)
+{
+    // faces are decoded on first use, but a missing one should fail now
+    for (int ii = 0; ii < 6; ii++) {
+        struct stat st;
+        std::string filename = facePath(ii, ".png");
+        if (stat(filename.c_str(), &st) != 0) {
+            printf("Error: cube map face %s not found\n", filename.c_str());
+            exit(1);
+        }
+    }
+}
+
+CubeMap::~CubeMap()
+{
+#ifdef CUBEMAP_PREAD
+    for (int ii = 0; ii < 6; ii++) {
+        if (_faces[ii].file >= 0) {
+            close(_faces[ii].file);
+        }
+    }
+#endif
+}
+
+std::string
+CubeMap::facePath(int f, const char *extension) const
+{
+    return _directory + "/" + sideNames[f] + extension;
+}
+
+void
+CubeMap::setCacheDirectory(const std::string &directory)
+{
+    _cacheDirectory = directory;
+}
+
+std::string
+CubeMap::cachePath(int f) const
+{
+    // named after the whole face path, so the faces of different cube
+    // maps never share a file
+    std::string name = facePath(f, ".texcache");
+    std::replace(name.begin(), name.end(), '/', '_');
+    std::replace(name.begin(), name.end(), '\\', '_');
+    std::replace(name.begin(), name.end(), ':', '_');
+    return _cacheDirectory + "/" + name;
+}
+
+void
+CubeMap::loadFace(int f) const
+{
+    if (!openCache(f)) {
+        decode(f);
+    }
+    // a fresh key, so tiles of an older copy of the face never match
+    _faces[f].texture = TextureCache::newTexture();
+    _faces[f].ready = true;
+}
+
+bool
+CubeMap::openCache(int f) const
 {
-    std::string side[6] = { "left", "right", "up", "down", "front", "back" };
-    for(int ii = 0 ;ii<6;ii++){
-        std::string filename = directory + "/" + side[ii] + ".png";
-        _images[ii] = Image::loadPNG(filename);
+    uint64_t sourceSize;
+    int64_t sourceTime;
+    if (_cacheDirectory.empty() || !sourceStamp(facePath(f, ".png"), sourceSize, sourceTime)) {
+        return false;
+    }
+    const std::string filename = cachePath(f);
+    FILE *file = fopen(filename.c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+    CacheHeader header;
+    struct stat st;
+    bool valid = fread(&header, sizeof(header), 1, file) == 1 &&
+        fstat(fileno(file), &st) == 0 &&
+        memcmp(header.magic, cacheMagic, sizeof(cacheMagic)) == 0 &&
+        header.version == cacheVersion &&
+        header.sourceSize == sourceSize && header.sourceTime == sourceTime &&
+        header.levels >= 1 && header.levels <= (uint32_t)maxLevels;
+    const size_t fileSize = valid ? (size_t)st.st_size : 0;
+    for (uint32_t l = 0; valid && l < header.levels; ++l) {
+        valid = header.width[l] > 0 && header.height[l] > 0 &&
+            header.tileWidth[l] == (uint32_t)tileSize && header.tileHeight[l] == (uint32_t)tileSize &&
+            header.offset[l] + levelBytes(header, l) <= fileSize;
+    }
+    if (!valid) {
+        fclose(file);
+        return false;
     }
 
+    Face &face = _faces[f];
+#ifdef CUBEMAP_PREAD
+    face.file = open(filename.c_str(), O_RDONLY);
+    fclose(file);
+    if (face.file < 0) {
+        return false;
+    }
+#else
+    // without pread the file is read whole
+    face.storage.resize(fileSize);
+    bool read = fseek(file, 0, SEEK_SET) == 0 &&
+        fread(face.storage.data(), 1, fileSize, file) == fileSize;
+    fclose(file);
+    if (!read) {
+        face.storage.clear();
+        return false;
+    }
+#endif
+
+    face.levels.resize(header.levels);
+    for (uint32_t l = 0; l < header.levels; ++l) {
+        Level &level = face.levels[l];
+        level.width = (int)header.width[l];
+        level.height = (int)header.height[l];
+        level.tilesX = (level.width + tileSize - 1) >> tileShift;
+        level.texelBytes = l == 0 ? 3 : 6;
+        level.offset = header.offset[l];
+    }
+    return true;
 }
 
+void
+CubeMap::decode(int f) const
+{
+    const std::string source = facePath(f, ".png");
+    int w, h, n;
+    unsigned char *buffer = stbi_load(source.c_str(), &w, &h, &n, 3);
+    if (!buffer) {
+        printf("Error: could not decode cube map face %s\n", source.c_str());
+        exit(1);
+    }
+
+    // lay the face out as its cache file, header first
+    CacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, cacheMagic, sizeof(cacheMagic));
+    header.version = cacheVersion;
+    sourceStamp(source, header.sourceSize, header.sourceTime);
+    size_t offset = alignUp(sizeof(header));
+    int lw = w;
+    int lh = h;
+    for (;;) {
+        const uint32_t l = header.levels++;
+        header.width[l] = (uint32_t)lw;
+        header.height[l] = (uint32_t)lh;
+        header.tileWidth[l] = (uint32_t)tileSize;
+        header.tileHeight[l] = (uint32_t)tileSize;
+        header.offset[l] = offset;
+        offset = alignUp(offset + levelBytes(header, l));
+        if ((lw == 1 && lh == 1) || header.levels == (uint32_t)maxLevels) {
+            break;
+        }
+        lw = std::max(1, lw / 2);
+        lh = std::max(1, lh / 2);
+    }
+
+    std::vector<uint8_t> data(offset, 0);
+    memcpy(data.data(), &header, sizeof(header));
+    for (int y = 0; y < h; ++y) {
+        for (int x = 0; x < w; ++x) {
+            memcpy(&data[tiledOffset(header, 0, x, y)], buffer + 3 * ((size_t)y * w + x), 3);
+        }
+    }
+
+    // the smaller levels are filtered from float texels, as loadPNG
+    // converts them
+    std::vector<float> image(3 * (size_t)w * h);
+    for (size_t i = 0; i < image.size(); ++i) {
+        image[i] = buffer[i] / 255.0f;
+    }
+    stbi_image_free(buffer);
+    for (uint32_t l = 1; l < header.levels; ++l) {
+        int rw, rh;
+        image = downsample(image, (int)header.width[l - 1], (int)header.height[l - 1], rw, rh);
+        for (int y = 0; y < rh; ++y) {
+            for (int x = 0; x < rw; ++x) {
+                uint16_t texel[3];
+                for (int c = 0; c < 3; ++c) {
+                    texel[c] = floatToHalf(image[3 * ((size_t)y * rw + x) + c]);
+                }
+                memcpy(&data[tiledOffset(header, l, x, y)], texel, sizeof(texel));
+            }
+        }
+    }
+
+    // write to a temporary name so a concurrent run never reads a partial
+    // file, then read tiles back from the cache file like any later run
+    const std::string filename = cachePath(f);
+    const std::string temporary = filename + ".tmp";
+    FILE *file = _cacheDirectory.empty() ? nullptr : fopen(temporary.c_str(), "wb");
+    if (file) {
+        bool written = fwrite(data.data(), 1, data.size(), file) == data.size();
+        written = fclose(file) == 0 && written;
+        if (written && rename(temporary.c_str(), filename.c_str()) == 0 && openCache(f)) {
+            return;
+        }
+        remove(temporary.c_str());
+    }
+
+    // no cache directory, or it is not writable: keep the face in memory
+    Face &face = _faces[f];
+    face.storage.swap(data);
+    face.levels.resize(header.levels);
+    for (uint32_t l = 0; l < header.levels; ++l) {
+        Level &level = face.levels[l];
+        level.width = (int)header.width[l];
+        level.height = (int)header.height[l];
+        level.tilesX = (level.width + tileSize - 1) >> tileShift;
+        level.texelBytes = l == 0 ? 3 : 6;
+        level.offset = header.offset[l];
+    }
+}
+
+void
+CubeMap::load(unsigned int mask) const
+{
+    int pending[6];
+    int count = 0;
+    for (int ii = 0; ii < 6; ii++) {
+        if ((mask >> ii) & 1 && !_faces[ii].ready) {
+            pending[count++] = ii;
+        }
+    }
+    parallelFor(0, count, [&](int i) { face(pending[i]); });
+}
+
+const uint8_t *
+CubeMap::tile(int f, int level, int tx, int ty) const
+{
+    const Face &fc = _faces[f];
+    const Level &l = fc.levels[level];
+    const int t = ty * l.tilesX + tx;
+    const size_t bytes = (size_t)tileSize * tileSize * l.texelBytes;
+    const uint64_t offset = l.offset + t * bytes;
+    if (!fc.storage.empty()) {
+        return &fc.storage[offset];
+    }
+
+    // the last tiles this thread used, so neighboring lookups skip the
+    // shared cache; a held tile stays valid after eviction. Slots go by
+    // tile and level parity, so the tiles of one filtered lookup never
+    // push each other out.
+    struct Recent
+    {
+        TextureCache::Key key = 0;
+        TextureCache::TilePtr tile;
+    };
+    thread_local Recent recent[8];
+    const TextureCache::Key key = TextureCache::key(fc.texture, level, t);
+    Recent &r = recent[(tx & 1) | (ty & 1) << 1 | (level & 1) << 2];
+    if (r.key != key) {
+        r.tile = TextureCache::global().get(key, [&](TextureCache::Tile &texels) {
+            texels.resize(bytes);
+            bool read = false;
+#ifdef CUBEMAP_PREAD
+            read = pread(fc.file, texels.data(), bytes, (off_t)offset) == (ssize_t)bytes;
+#endif
+            if (!read) {
+                printf("Error: could not read %s\n", cachePath(f).c_str());
+                exit(1);
+            }
+        });
+        r.key = key;
+    }
+    return r.tile->data();
+}
+
+Vector3f
+CubeMap::getTexturePixel(const Level &level, int index, const uint8_t *tile, int x, int y)
+{
+    const uint8_t *texel = tile +
+        ((size_t)(y & (tileSize - 1)) * tileSize + (x & (tileSize - 1))) * level.texelBytes;
+    if (index == 0) {
+        return Vector3f(texel[0] / 255.0f, texel[1] / 255.0f, texel[2] / 255.0f);
+    }
+    uint16_t half[3];
+    memcpy(half, texel, sizeof(half));
+    return Vector3f(halfToFloat(half[0]), halfToFloat(half[1]), halfToFloat(half[2]));
+}
 
 Vector3f
 CubeMap::getFaceTexel(float x, float y, int face) const
 {
-    x = x * _images[face].getWidth();
-    y = (1 - y) * _images[face].getHeight();
+    return getFaceTexel(x, y, face, 0);
+}
+
+Vector3f
+CubeMap::getFaceTexel(float x, float y, int f, int level) const
+{
+    const Level &image = face(f).levels[level];
+    x = x * image.width;
+    y = (1 - y) * image.height;
     int ix = (int) x;
     int iy = (int) y;
     float alpha = x - ix;
     float beta = y - iy;
 
-    const Vector3f &pixel0 = getTexturePixel(ix + 0, iy + 0, face);
-    const Vector3f &pixel1 = getTexturePixel(ix + 1, iy + 0, face);
-    const Vector3f &pixel2 = getTexturePixel(ix + 0, iy + 1, face);
-    const Vector3f &pixel3 = getTexturePixel(ix + 1, iy + 1, face);
+    const int x0 = clamp(ix, 0, image.width - 1);
+    const int x1 = clamp(ix + 1, 0, image.width - 1);
+    const int y0 = clamp(iy, 0, image.height - 1);
+    const int y1 = clamp(iy + 1, 0, image.height - 1);
+
+    // the four texels usually share a tile
+    const int tx0 = x0 >> tileShift;
+    const int tx1 = x1 >> tileShift;
+    const int ty0 = y0 >> tileShift;
+    const int ty1 = y1 >> tileShift;
+    const uint8_t *tile0 = tile(f, level, tx0, ty0);
+    const uint8_t *tile1 = tx1 == tx0 ? tile0 : tile(f, level, tx1, ty0);
+    const uint8_t *tile2 = ty1 == ty0 ? tile0 : tile(f, level, tx0, ty1);
+    const uint8_t *tile3 = ty1 == ty0 ? tile1 : tx1 == tx0 ? tile2 : tile(f, level, tx1, ty1);
+
+    const Vector3f pixel0 = getTexturePixel(image, level, tile0, x0, y0);
+    const Vector3f pixel1 = getTexturePixel(image, level, tile1, x1, y0);
+    const Vector3f pixel2 = getTexturePixel(image, level, tile2, x0, y1);
+    const Vector3f pixel3 = getTexturePixel(image, level, tile3, x1, y1);
 
     Vector3f color;
     for (int ii = 0; ii < 3; ii++) {
-        color[ii] = 
+        color[ii] =
               (1 - alpha) * (1 - beta) * pixel0[ii]
             +      alpha  * (1 - beta) * pixel1[ii]
             + (1 - alpha) *      beta  * pixel2[ii]
@@ -42,43 +450,176 @@ CubeMap::getFaceTexel(float x, float y, int face) const
     return color;
 }
 
-
-Vector3f
-CubeMap::getTexel(const Vector3f &direction) const
+void
+CubeMap::faceCoords(const Vector3f &direction, int &face, float &x, float &y)
 {
     Vector3f dir = direction.normalized();
-    Vector3f outputColor(0.0f, 0.0f, 0.0f);
+    face = -1;
     if ((std::abs(dir[0]) >= std::abs(dir[1])) && (std::abs(dir[0]) >= std::abs(dir[2]))) {
         if (dir[0] > 0.0f) {
-            outputColor = 
-                getFaceTexel((dir[2] / dir[0] + 1.0f) * 0.5f, 
-                                   (dir[1] / dir[0] + 1.0f) * 0.5f, RIGHT);
+            face = RIGHT;
+            x = (dir[2] / dir[0] + 1.0f) * 0.5f;
+            y = (dir[1] / dir[0] + 1.0f) * 0.5f;
         } else if (dir[0] < 0.0f) {
-            outputColor = 
-                getFaceTexel(       (dir[2] / dir[0] + 1.0f) * 0.5f, 
-                                  1.0f - (dir[1] / dir[0] + 1.0f) * 0.5f, LEFT);
+            face = LEFT;
+            x = (dir[2] / dir[0] + 1.0f) * 0.5f;
+            y = 1.0f - (dir[1] / dir[0] + 1.0f) * 0.5f;
         }
     } else if ((std::abs(dir[1]) >= std::abs(dir[0])) && (std::abs(dir[1]) >= std::abs(dir[2]))) {
         if (dir[1] > 0.0f) {
-            outputColor = 
-                getFaceTexel((dir[0] / dir[1] + 1.0f) * 0.5f, 
-                                (dir[2] / dir[1] + 1.0f) * 0.5f, UP);
+            face = UP;
+            x = (dir[0] / dir[1] + 1.0f) * 0.5f;
+            y = (dir[2] / dir[1] + 1.0f) * 0.5f;
         } else if (dir[1] < 0.0f) {
-            outputColor = 
-                getFaceTexel(1.0f - (dir[0] / dir[1] + 1.0f) * 0.5f, 
-                                  1.0f - (dir[2] / dir[1] + 1.0f) * 0.5f, DOWN);
+            face = DOWN;
+            x = 1.0f - (dir[0] / dir[1] + 1.0f) * 0.5f;
+            y = 1.0f - (dir[2] / dir[1] + 1.0f) * 0.5f;
         }
     } else if ((std::abs(dir[2]) >= std::abs(dir[0])) && (std::abs(dir[2]) >= std::abs(dir[1]))) {
         if (dir[2] > 0.0f) {
-            outputColor = 
-                getFaceTexel(1.0f - (dir[0] / dir[2] + 1.0f) * 0.5f, 
-                                          (dir[1] / dir[2] + 1.0f) * 0.5f, FRONT);
+            face = FRONT;
+            x = 1.0f - (dir[0] / dir[2] + 1.0f) * 0.5f;
+            y = (dir[1] / dir[2] + 1.0f) * 0.5f;
         } else if (dir[2] < 0.0f) {
-            outputColor = 
-                getFaceTexel(       (dir[0] / dir[2] + 1.0f) * 0.5f, 
-                                  1.0f - (dir[1] / dir[2] + 1.0f) * 0.5f, BACK);
+            face = BACK;
+            x = (dir[0] / dir[2] + 1.0f) * 0.5f;
+            y = 1.0f - (dir[1] / dir[2] + 1.0f) * 0.5f;
         }
     }
+}
 
-    return outputColor;
+Vector3f
+CubeMap::getTexel(const Vector3f &direction) const
+{
+    int face;
+    float x, y;
+    faceCoords(direction, face, x, y);
+    if (face < 0) {
+        return Vector3f(0.0f, 0.0f, 0.0f);
+    }
+    return getFaceTexel(x, y, face);
+}
+
+Vector3f
+CubeMap::sampleLevels(float x, float y, int face, float spread) const
+{
+    // a texel of the full-resolution face spans about 2 / width radians,
+    // and a bilinear lookup already blends two texels across
+    const std::vector<Level> &levels = this->face(face).levels;
+    float lod = std::log2(spread * levels[0].width * 0.25f);
+    if (!(lod > 0)) {
+        return getFaceTexel(x, y, face);
+    }
+    const int last = (int)levels.size() - 1;
+    int level = (int)lod;
+    if (level >= last) {
+        return getFaceTexel(x, y, face, last);
+    }
+    float t = lod - level;
+    return (1 - t) * getFaceTexel(x, y, face, level) + t * getFaceTexel(x, y, face, level + 1);
+}
+
+Vector3f
+CubeMap::getTexel(const Vector3f &direction, float spread) const
+{
+    int face;
+    float x, y;
+    faceCoords(direction, face, x, y);
+    if (face < 0) {
+        return Vector3f(0.0f, 0.0f, 0.0f);
+    }
+    return sampleLevels(x, y, face, spread);
+}
+
+void
+CubeMap::getTexels(const float *dx, const float *dy, const float *dz, int n,
+                   float spread, float *r, float *g, float *b) const
+{
+    // faces and face coordinates of the whole batch first, so the faces
+    // it needs can be decoded together
+    thread_local std::vector<int> faces;
+    thread_local std::vector<float> us, vs;
+    faces.resize(n);
+    us.resize(n);
+    vs.resize(n);
+
+    int i = 0;
+#if defined( VECMATH_SSE )
+    // the same operations as faceCoords, four directions at a time
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    for (; i + 4 <= n; i += 4) {
+        __m128 x = _mm_loadu_ps(dx + i);
+        __m128 y = _mm_loadu_ps(dy + i);
+        __m128 z = _mm_loadu_ps(dz + i);
+        __m128 len = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)),
+                                            _mm_mul_ps(z, z)));
+        x = _mm_div_ps(x, len);
+        y = _mm_div_ps(y, len);
+        z = _mm_div_ps(z, len);
+        __m128 ax = _mm_andnot_ps(sign, x);
+        __m128 ay = _mm_andnot_ps(sign, y);
+        __m128 az = _mm_andnot_ps(sign, z);
+
+        __m128 isX = _mm_and_ps(_mm_cmpge_ps(ax, ay), _mm_cmpge_ps(ax, az));
+        __m128 isY = _mm_andnot_ps(isX, _mm_and_ps(_mm_cmpge_ps(ay, ax), _mm_cmpge_ps(ay, az)));
+        __m128 isZ = _mm_andnot_ps(_mm_or_ps(isX, isY), _mm_and_ps(_mm_cmpge_ps(az, ax), _mm_cmpge_ps(az, ay)));
+
+        // major axis, and the numerators of the two face coordinates
+        __m128 m = _mm_or_ps(_mm_and_ps(isX, x), _mm_or_ps(_mm_and_ps(isY, y), _mm_and_ps(isZ, z)));
+        __m128 nu = _mm_or_ps(_mm_and_ps(isX, z), _mm_andnot_ps(isX, x));
+        __m128 nv = _mm_or_ps(_mm_and_ps(isY, z), _mm_andnot_ps(isY, y));
+        __m128 u = _mm_mul_ps(_mm_add_ps(_mm_div_ps(nu, m), one), half);
+        __m128 v = _mm_mul_ps(_mm_add_ps(_mm_div_ps(nv, m), one), half);
+
+        // LEFT, DOWN and BACK flip v; DOWN and FRONT flip u
+        __m128 pos = _mm_cmpgt_ps(m, zero);
+        __m128 neg = _mm_cmplt_ps(m, zero);
+        __m128 flipU = _mm_or_ps(_mm_and_ps(isY, neg), _mm_and_ps(isZ, pos));
+        u = _mm_or_ps(_mm_and_ps(flipU, _mm_sub_ps(one, u)), _mm_andnot_ps(flipU, u));
+        v = _mm_or_ps(_mm_and_ps(neg, _mm_sub_ps(one, v)), _mm_andnot_ps(neg, v));
+
+        _mm_storeu_ps(&us[i], u);
+        _mm_storeu_ps(&vs[i], v);
+        const int maskX = _mm_movemask_ps(isX);
+        const int maskY = _mm_movemask_ps(isY);
+        const int maskZ = _mm_movemask_ps(isZ);
+        const int maskPos = _mm_movemask_ps(pos);
+        const int maskNeg = _mm_movemask_ps(neg);
+        for (int k = 0; k < 4; ++k) {
+            const int bit = 1 << k;
+            int face = -1;
+            if (maskPos & bit || maskNeg & bit) {
+                if (maskX & bit) {
+                    face = (maskPos & bit) ? RIGHT : LEFT;
+                } else if (maskY & bit) {
+                    face = (maskPos & bit) ? UP : DOWN;
+                } else if (maskZ & bit) {
+                    face = (maskPos & bit) ? FRONT : BACK;
+                }
+            }
+            faces[i + k] = face;
+        }
+    }
+#endif
+    for (; i < n; ++i) {
+        faceCoords(Vector3f(dx[i], dy[i], dz[i]), faces[i], us[i], vs[i]);
+    }
+
+    unsigned int mask = 0;
+    for (i = 0; i < n; ++i) {
+        if (faces[i] >= 0) {
+            mask |= 1u << faces[i];
+        }
+    }
+    load(mask);
+
+    for (i = 0; i < n; ++i) {
+        Vector3f c = faces[i] < 0 ? Vector3f(0.0f, 0.0f, 0.0f) : sampleLevels(us[i], vs[i], faces[i], spread);
+        r[i] = c[0];
+        g[i] = c[1];
+        b[i] = c[2];
+    }
 }
@@ -2,11 +2,16 @@
 #define CUBEMAP_H
 
 #include "Image.h"
+#include "TextureCache.h"
 #include "Vector3f.h"
 
+#include <atomic>
+#include <cstdint>
+#include <mutex>
 #include <string>
 #include "Vector3f.h"
 #include <iostream>
+#include <vector>
 
 class CubeMap {
 public:
@@ -20,17 +25,114 @@ public:
     };
 
     // Assumes a directory containing {left,right,up,down,front,back}.png
+    // Faces are only decoded when first looked up. Each face is followed
+    // by a mip pyramid of 2x2 box-filtered levels. The full-resolution
+    // level keeps the 8-bit texels of the PNG; the smaller levels are
+    // stored as half floats.
+    //
+    // Decoded faces stay in memory unless a cache directory is set. There
+    // each face is written as a .texcache file, cut into square tiles.
+    // Lookups read tiles from that file on demand through
+    // TextureCache::global(), so memory stays within the cache's budget
+    // whatever the size of the faces, and later runs skip the decoding.
+    // The cache file is rebuilt if the PNG has changed since; if the
+    // directory is not writable the decoded face stays in memory.
     CubeMap(const std::string &directory);
+    ~CubeMap();
+
+    CubeMap(const CubeMap &) = delete;
+    CubeMap &operator=(const CubeMap &) = delete;
 
     // Returns color for given directory
     Vector3f getTexel(const Vector3f &direction) const;
 
+    // Color seen by a cone of rays around direction, spread radians wide.
+    // The mip level is picked so one texel covers about the cone, and
+    // the two nearest levels are blended. A spread below one texel of
+    // the full-resolution face gives the same result as getTexel.
+    Vector3f getTexel(const Vector3f &direction, float spread) const;
+
+    // getTexel(direction, spread) for n directions in structure-of-arrays
+    // form, writing to r, g, b. Faces and face coordinates are computed
+    // four at a time with SSE when vecmath is built with VECMATH_SIMD.
+    // Faces the batch needs that are not decoded yet are decoded in
+    // parallel first.
+    void getTexels(const float *dx, const float *dy, const float *dz, int n,
+                   float spread, float *r, float *g, float *b) const;
+
     // The UV (x, y) coordinates are assumed to be normalized between 0 and 1.
     // The resulting look up is box filtered in the local 2x2 neighborhood.
     Vector3f getFaceTexel(float x, float y, int face) const;
 
+    // getFaceTexel on mip level (0 is full resolution)
+    Vector3f getFaceTexel(float x, float y, int face, int level) const;
+
+    int getNumLevels() const {
+        return (int)face(0).levels.size();
+    }
+
+    // Decodes the faces whose bit (1 << face) is set in mask and that
+    // are not decoded yet, in parallel.
+    void load(unsigned int mask) const;
+
+    // Directory that decoded faces of every cube map are cached in, or
+    // empty (the default) to decode them on each run. Call it before any
+    // face is looked up.
+    static void setCacheDirectory(const std::string &directory);
+
 private:
-    Image _images[6];
+    struct Level
+    {
+        int width;
+        int height;
+        // tiles per row
+        int tilesX;
+        // 3 for 8-bit level 0, 6 for half-float levels
+        int texelBytes;
+        // of the first tile in the cache file
+        uint64_t offset;
+    };
+
+    struct Face
+    {
+        std::once_flag loaded;
+        std::atomic<bool> ready{ false };
+        TextureCache::Key texture = 0;
+        std::vector<Level> levels;
+        // the cache file tiles are read from
+        int file = -1;
+        // the whole cache file, when it could not be written or the
+        // platform has no pread
+        std::vector<uint8_t> storage;
+    };
+
+    const Face &face(int f) const {
+        std::call_once(_faces[f].loaded, [this, f]() { loadFace(f); });
+        return _faces[f];
+    }
+
+    std::string facePath(int f, const char *extension) const;
+    std::string cachePath(int f) const;
+    void loadFace(int f) const;
+    bool openCache(int f) const;
+    void decode(int f) const;
+
+    // Texels of tile (tx, ty) of a loaded face's level, laid out in rows
+    // of 64 texels. Valid until the calling thread fetches another
+    // tile with the same tile and level parity.
+    const uint8_t *tile(int f, int level, int tx, int ty) const;
+
+    // Face and face coordinates of a direction, as used by getTexel; face
+    // is -1 for a zero direction.
+    static void faceCoords(const Vector3f &direction, int &face, float &x, float &y);
+
+    // Blends the two mip levels around the one matching spread.
+    Vector3f sampleLevels(float x, float y, int face, float spread) const;
+
+    std::string _directory;
+
+    static std::string _cacheDirectory;
+    mutable Face _faces[6];
 
     template<typename T>
     static T
@@ -47,11 +149,8 @@ private:
         }
     }
 
-    const Vector3f & getTexturePixel(int x, int y, int face) const {
-        x = clamp(x, 0, _images[face].getWidth() - 1);
-        y = clamp(y, 0, _images[face].getHeight() - 1);
-        return _images[face].getPixel(x, y);
-    }
+    // Texel (x, y) of level index, which lies in tile.
+    static Vector3f getTexturePixel(const Level &level, int index, const uint8_t *tile, int x, int y);
 
 };
 
@@ -0,0 +1,126 @@
+#include "Denoiser.h"
+#include "Parallel.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <vector>
+
+Image
+Denoiser::denoise(const Image &color,
+                  const Image &normal,
+                  const Image &depth) const
+{
+    const int w = color.getWidth();
+    const int h = color.getHeight();
+    assert(normal.getWidth() == w && normal.getHeight() == h);
+    assert(depth.getWidth() == w && depth.getHeight() == h);
+
+    // Decode the guides once: unit normals, depth and its screen-space
+    // gradient (one-sided minimum, so silhouettes do not inflate it).
+    std::vector<float> n(3 * w * h);
+    std::vector<float> z(w * h);
+    std::vector<float> dz(w * h);
+
+    parallelFor(0, h, [&](int y) {
+        std::vector<float> row(6 * w);
+        float *nrow[3] = { &row[0], &row[w], &row[2 * w] };
+        float *zrow = &row[3 * w];
+        normal.readRow(y, nrow[0], nrow[1], nrow[2]);
+        depth.readRow(y, zrow, &row[4 * w], &row[5 * w]);
+        for (int x = 0; x < w; ++x) {
+            float nx = 2 * nrow[0][x] - 1;
+            float ny = 2 * nrow[1][x] - 1;
+            float nz = 2 * nrow[2][x] - 1;
+            float len = std::sqrt(nx * nx + ny * ny + nz * nz);
+            float inv = len > 0 ? 1.0f / len : 0.0f;
+            int p = y * w + x;
+            n[3 * p + 0] = nx * inv;
+            n[3 * p + 1] = ny * inv;
+            n[3 * p + 2] = nz * inv;
+            z[p] = zrow[x];
+        }
+    });
+
+    parallelFor(0, h, [&](int y) {
+        for (int x = 0; x < w; ++x) {
+            int p = y * w + x;
+            float gx = std::min(x > 0 ? std::fabs(z[p] - z[p - 1]) : HUGE_VALF,
+                                x < w - 1 ? std::fabs(z[p + 1] - z[p]) : HUGE_VALF);
+            float gy = std::min(y > 0 ? std::fabs(z[p] - z[p - w]) : HUGE_VALF,
+                                y < h - 1 ? std::fabs(z[p + w] - z[p]) : HUGE_VALF);
+            float g = std::max(gx == HUGE_VALF ? 0 : gx, gy == HUGE_VALF ? 0 : gy);
+            dz[p] = std::isfinite(g) ? g : 0.0f;
+        }
+    });
+
+    static const float kernel[5] = { 1 / 16.0f, 1 / 4.0f, 3 / 8.0f, 1 / 4.0f, 1 / 16.0f };
+
+    Image src = color.converted(Image::FLOAT32);
+    Image dst(w, h);
+    float sigmaColor = _sigmaColor;
+
+    for (int it = 0; it < _iterations; ++it) {
+        const int step = 1 << it;
+        const float invColor = 1.0f / (sigmaColor * sigmaColor);
+
+        parallelFor(0, h, [&](int y) {
+            float *out[3] = { dst.getRow(0, y), dst.getRow(1, y), dst.getRow(2, y) };
+            const float *row[3] = { src.getRow(0, y), src.getRow(1, y), src.getRow(2, y) };
+            for (int x = 0; x < w; ++x) {
+                const int p = y * w + x;
+                const float cp[3] = { row[0][x], row[1][x], row[2][x] };
+                const float *np = &n[3 * p];
+                const float zp = z[p];
+                const bool missP = np[0] == 0 && np[1] == 0 && np[2] == 0;
+                const float zscale = 1.0f / (_sigmaDepth * dz[p] * step + 1e-4f);
+
+                float r = 0, g = 0, b = 0, wsum = 0;
+                for (int j = 0; j < 5; ++j) {
+                    int qy = std::min(std::max(y + (j - 2) * step, 0), h - 1);
+                    const float *crow[3] = { src.getRow(0, qy), src.getRow(1, qy), src.getRow(2, qy) };
+                    for (int i = 0; i < 5; ++i) {
+                        int qx = std::min(std::max(x + (i - 2) * step, 0), w - 1);
+                        int q = qy * w + qx;
+                        const float cq[3] = { crow[0][qx], crow[1][qx], crow[2][qx] };
+
+                        float d0 = cp[0] - cq[0];
+                        float d1 = cp[1] - cq[1];
+                        float d2 = cp[2] - cq[2];
+                        float wc = std::exp(-(d0 * d0 + d1 * d1 + d2 * d2) * invColor);
+
+                        // background samples carry a zero normal and only
+                        // blend with each other
+                        float ndot = np[0] * n[3 * q] + np[1] * n[3 * q + 1] + np[2] * n[3 * q + 2];
+                        bool missQ = n[3 * q] == 0 && n[3 * q + 1] == 0 && n[3 * q + 2] == 0;
+                        float wn = (missP && missQ) ? 1.0f
+                            : std::pow(std::max(ndot, 0.0f), _sigmaNormal);
+
+                        float wz = std::exp(-std::fabs(zp - z[q]) * zscale);
+
+                        float wt = kernel[i] * kernel[j] * wc * wn * wz;
+                        r += wt * cq[0];
+                        g += wt * cq[1];
+                        b += wt * cq[2];
+                        wsum += wt;
+                    }
+                }
+
+                if (wsum > 0) {
+                    out[0][x] = r / wsum;
+                    out[1][x] = g / wsum;
+                    out[2][x] = b / wsum;
+                } else {
+                    out[0][x] = cp[0];
+                    out[1][x] = cp[1];
+                    out[2][x] = cp[2];
+                }
+            }
+        });
+
+        std::swap(src, dst);
+        sigmaColor *= 0.5f;
+    }
+
+    return src;
+}
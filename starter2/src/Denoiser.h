@@ -0,0 +1,39 @@
+#ifndef DENOISER_H
+#define DENOISER_H
+
+#include "Image.h"
+
+// Edge-avoiding A-trous wavelet denoiser (Dammertz et al. 2010).
+// Repeatedly applies a 5x5 B3-spline kernel with growing holes, and
+// stops at edges found in the color, normal and depth buffers.
+class Denoiser
+{
+public:
+    // sigmaColor: tolerance on color differences, halved each iteration.
+    // sigmaNormal: exponent on the normal similarity (higher is stricter).
+    // sigmaDepth: tolerance on depth differences, relative to the local
+    // depth gradient.
+    Denoiser(int iterations = 5,
+             float sigmaColor = 0.1f,
+             float sigmaNormal = 64.0f,
+             float sigmaDepth = 1.0f) :
+        _iterations(iterations),
+        _sigmaColor(sigmaColor),
+        _sigmaNormal(sigmaNormal),
+        _sigmaDepth(sigmaDepth)
+    { }
+
+    // normal is expected in the renderer's (n + 1) / 2 encoding and depth
+    // as a single value replicated over the three channels.
+    Image denoise(const Image &color,
+                  const Image &normal,
+                  const Image &depth) const;
+
+private:
+    int _iterations;
+    float _sigmaColor;
+    float _sigmaNormal;
+    float _sigmaDepth;
+};
+
+#endif // DENOISER_H
@@ -0,0 +1,214 @@
+#include "Filter.h"
+#include "Parallel.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <vector>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+static
+float
+sinc(float x)
+{
+    if (std::fabs(x) < 1e-5f) {
+        return 1.0f;
+    }
+    float px = (float)M_PI * x;
+    return std::sin(px) / px;
+}
+
+// Mitchell-Netravali cubic with B = C = 1/3, support [-2, 2].
+static
+float
+mitchell(float x)
+{
+    const float B = 1.0f / 3.0f;
+    const float C = 1.0f / 3.0f;
+    x = std::fabs(x);
+    if (x < 1.0f) {
+        return ((12 - 9 * B - 6 * C) * x * x * x
+            + (-18 + 12 * B + 6 * C) * x * x
+            + (6 - 2 * B)) / 6.0f;
+    }
+    if (x < 2.0f) {
+        return ((-B - 6 * C) * x * x * x
+            + (6 * B + 30 * C) * x * x
+            + (-12 * B - 48 * C) * x
+            + (8 * B + 24 * C)) / 6.0f;
+    }
+    return 0.0f;
+}
+
+Filter::Filter(Type type, float radius) :
+    _type(type),
+    _radius(radius)
+{
+    if (_radius <= 0) {
+        switch (_type) {
+        case BOX:      _radius = 0.5f; break;
+        case TENT:     _radius = 1.0f; break;
+        case GAUSSIAN: _radius = 1.5f; break;
+        case MITCHELL: _radius = 2.0f; break;
+        case LANCZOS:  _radius = 2.0f; break;
+        case BINOMIAL: _radius = 1.0f; break;
+        }
+    }
+}
+
+bool
+Filter::parseType(const std::string &name, Type &type)
+{
+    if (name == "box") {
+        type = BOX;
+    } else if (name == "tent") {
+        type = TENT;
+    } else if (name == "gaussian") {
+        type = GAUSSIAN;
+    } else if (name == "mitchell") {
+        type = MITCHELL;
+    } else if (name == "lanczos") {
+        type = LANCZOS;
+    } else if (name == "binomial") {
+        type = BINOMIAL;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+float
+Filter::evaluate(float x) const
+{
+    x = std::fabs(x);
+    if (_type == BINOMIAL) {
+        // taps fall on whole samples: weight 2 at the center, 1 beside it
+        return x < 0.5f ? 2.0f : (x < 1.5f ? 1.0f : 0.0f);
+    }
+    if (x > _radius) {
+        return 0.0f;
+    }
+
+    switch (_type) {
+    case BOX:
+        return 1.0f;
+    case TENT:
+        return 1.0f - x / _radius;
+    case GAUSSIAN: {
+        // truncated at 3 sigma and shifted so the kernel reaches 0 at the edge
+        float sigma = _radius / 3.0f;
+        float a = 1.0f / (2.0f * sigma * sigma);
+        return std::exp(-a * x * x) - std::exp(-a * _radius * _radius);
+    }
+    case MITCHELL:
+        return mitchell(2.0f * x / _radius);
+    case LANCZOS:
+        return sinc(x) * sinc(x / _radius);
+    }
+    return 0.0f;
+}
+
+Filter::Taps
+Filter::buildTaps(int srcSize, int dstSize) const
+{
+    float scale = srcSize / (float)dstSize;
+    // support in source samples; at least one sample for magnification
+    float support = std::max(_radius * scale, 0.5f);
+    if (_type == BINOMIAL) {
+        support = 1.0f;
+    }
+
+    Taps t;
+    t.taps = (int)std::ceil(2 * support) + 1;
+    t.index.resize(dstSize * t.taps);
+    t.weight.resize(dstSize * t.taps);
+
+    for (int i = 0; i < dstSize; ++i) {
+        float center = (i + 0.5f) * scale - 0.5f;
+        if (_type == BINOMIAL) {
+            center = std::floor(i * scale);
+        }
+        int first = (int)std::ceil(center - support);
+
+        float sum = 0;
+        for (int k = 0; k < t.taps; ++k) {
+            int j = first + k;
+            float w = (_type == BINOMIAL) ? evaluate(j - center) :
+                evaluate((j - center) / scale);
+            t.index[i * t.taps + k] = std::min(std::max(j, 0), srcSize - 1);
+            t.weight[i * t.taps + k] = w;
+            sum += w;
+        }
+
+        if (std::fabs(sum) < 1e-8f) {
+            // kernel missed every sample: fall back to nearest neighbour
+            int nearest = std::min(std::max((int)std::floor(center + 0.5f), 0), srcSize - 1);
+            for (int k = 0; k < t.taps; ++k) {
+                t.index[i * t.taps + k] = nearest;
+                t.weight[i * t.taps + k] = (k == 0) ? 1.0f : 0.0f;
+            }
+            continue;
+        }
+        for (int k = 0; k < t.taps; ++k) {
+            t.weight[i * t.taps + k] /= sum;
+        }
+    }
+    return t;
+}
+
+Image
+Filter::apply(const Image &img, int w, int h) const
+{
+    assert(w > 0 && h > 0);
+    const int srcW = img.getWidth();
+    const int srcH = img.getHeight();
+
+    const Taps tx = buildTaps(srcW, w);
+    const Taps ty = buildTaps(srcH, h);
+
+    // horizontal pass: (srcW, srcH) -> (w, srcH)
+    Image tmp(w, srcH);
+    parallelFor(0, srcH, [&](int y) {
+        std::vector<float> row(3 * srcW);
+        float *src[3] = { &row[0], &row[srcW], &row[2 * srcW] };
+        img.readRow(y, src[0], src[1], src[2]);
+        for (int c = 0; c < 3; ++c) {
+            float *dst = tmp.getRow(c, y);
+            for (int x = 0; x < w; ++x) {
+                const int *idx = &tx.index[x * tx.taps];
+                const float *wt = &tx.weight[x * tx.taps];
+                float v = 0;
+                for (int k = 0; k < tx.taps; ++k) {
+                    v += wt[k] * src[c][idx[k]];
+                }
+                dst[x] = v;
+            }
+        }
+    });
+
+    // vertical pass: (w, srcH) -> (w, h). Each tap scales a whole source
+    // row, so the inner loop runs over a contiguous channel row.
+    Image result(w, h);
+    parallelFor(0, h, [&](int y) {
+        const int *idx = &ty.index[y * ty.taps];
+        const float *wt = &ty.weight[y * ty.taps];
+        for (int c = 0; c < 3; ++c) {
+            float *dst = result.getRow(c, y);
+            for (int k = 0; k < ty.taps; ++k) {
+                if (wt[k] == 0) {
+                    continue;
+                }
+                const float *src = tmp.getRow(c, idx[k]);
+                const float weight = wt[k];
+                for (int i = 0; i < w; ++i) {
+                    dst[i] += weight * src[i];
+                }
+            }
+        }
+    });
+
+    return result;
+}
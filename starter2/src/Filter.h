@@ -0,0 +1,68 @@
+#ifndef FILTER_H
+#define FILTER_H
+
+#include "Image.h"
+
+#include <string>
+#include <vector>
+
+// Separable reconstruction filter used to resolve a super-sampled image
+// down to the output resolution. The kernel is evaluated in output pixel
+// units, so the same filter works for any supersampling factor. The
+// exception is BINOMIAL, the renderer's original filter: the [1, 2, 1]
+// kernel over the first sample of each block and its two neighbours.
+class Filter
+{
+public:
+    enum Type {
+        BOX,
+        TENT,
+        GAUSSIAN,
+        MITCHELL,
+        LANCZOS,
+        BINOMIAL,
+    };
+
+    // radius is the kernel support in output pixels; a value <= 0 selects
+    // the default support of the kernel. Wider supports trade sharpness
+    // for smoother results (and more lobes for Lanczos). BINOMIAL has a
+    // fixed support and ignores radius.
+    Filter(Type type = BINOMIAL, float radius = 0);
+
+    // Look up a kernel by name (box, tent, gaussian, mitchell, lanczos,
+    // binomial).
+    // Returns false if the name is unknown.
+    static bool parseType(const std::string &name, Type &type);
+
+    Type getType() const {
+        return _type;
+    }
+
+    float getRadius() const {
+        return _radius;
+    }
+
+    // Kernel weight at distance x (in output pixels, or in samples for
+    // BINOMIAL) from the pixel center.
+    float evaluate(float x) const;
+
+    // Resamples img to a (w, h) image. Runs a horizontal then a vertical
+    // pass, each parallel over rows.
+    Image apply(const Image &img, int w, int h) const;
+
+private:
+    // Precomputed taps for one axis: for output pixel i, the source
+    // indices and normalized weights are stored at [i * taps, (i + 1) * taps).
+    struct Taps {
+        int taps;
+        std::vector<int> index;
+        std::vector<float> weight;
+    };
+
+    Taps buildTaps(int srcSize, int dstSize) const;
+
+    Type _type;
+    float _radius;
+};
+
+#endif // FILTER_H
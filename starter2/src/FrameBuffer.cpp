@@ -0,0 +1,40 @@
+#include "FrameBuffer.h"
+#include "Filter.h"
+
+FrameBuffer::FrameBuffer(int w, int h, unsigned int aovs, Image::Format format) :
+    _width(w),
+    _height(h),
+    _aovs(aovs)
+{
+    for (int a = 0; a < AOV_COUNT; ++a) {
+        if (has((AOV)a)) {
+            _images[a] = Image(w, h, format);
+        }
+    }
+}
+
+void
+FrameBuffer::addSample(int x, int y, const AOVSample &s, float weight)
+{
+    for (int a = 0; a < AOV_COUNT; ++a) {
+        if (has((AOV)a)) {
+            Image &img = _images[a];
+            img.setPixel(x, y, img.getPixel(x, y) + weight * s.value[a]);
+        }
+    }
+}
+
+FrameBuffer
+FrameBuffer::filtered(const Filter &filter, int w, int h) const
+{
+    FrameBuffer result;
+    result._width = w;
+    result._height = h;
+    result._aovs = _aovs;
+    for (int a = 0; a < AOV_COUNT; ++a) {
+        if (has((AOV)a)) {
+            result._images[a] = filter.apply(_images[a], w, h);
+        }
+    }
+    return result;
+}
@@ -0,0 +1,89 @@
+#ifndef FRAME_BUFFER_H
+#define FRAME_BUFFER_H
+
+#include "Image.h"
+#include "Vector3f.h"
+
+class Filter;
+
+// Arbitrary output variables the renderer can produce.
+enum AOV {
+    AOV_COLOR,
+    AOV_NORMAL,
+    AOV_DEPTH,
+    AOV_OBJECT_ID,
+    AOV_MATERIAL_ID,
+    AOV_HIT_COUNT,
+    AOV_COST,
+    AOV_COUNT
+};
+
+inline unsigned int
+aovBit(AOV a)
+{
+    return 1u << a;
+}
+
+// Per-sample values for every AOV. Only the entries enabled in the
+// frame buffer are filled in by the renderer.
+struct AOVSample
+{
+    Vector3f value[AOV_COUNT];
+};
+
+// Set of images, one per requested AOV. Images for AOVs that were not
+// requested are never allocated. All images share one storage format; a
+// UINT8 frame buffer takes a quarter of the memory but only holds pixels
+// that are written once.
+class FrameBuffer
+{
+public:
+    FrameBuffer() : _width(0), _height(0), _aovs(0) {}
+    FrameBuffer(int w, int h, unsigned int aovs, Image::Format format = Image::FLOAT32);
+
+    int getWidth() const {
+        return _width;
+    }
+
+    int getHeight() const {
+        return _height;
+    }
+
+    unsigned int getAOVs() const {
+        return _aovs;
+    }
+
+    bool has(AOV a) const {
+        return (_aovs & aovBit(a)) != 0;
+    }
+
+    const Image & getImage(AOV a) const {
+        assert(has(a));
+        return _images[a];
+    }
+
+    Image & getImage(AOV a) {
+        assert(has(a));
+        return _images[a];
+    }
+
+    // Add weight * sample to pixel (x, y) of every enabled AOV.
+    void addSample(int x, int y, const AOVSample &s, float weight = 1.0f);
+
+    // Add v to pixel (x, y) of a single enabled AOV.
+    void add(AOV a, int x, int y, const Vector3f &v) {
+        assert(has(a));
+        _images[a].setPixel(x, y, _images[a].getPixel(x, y) + v);
+    }
+
+    // Resample every enabled AOV to (w, h) with the given filter.
+    FrameBuffer filtered(const Filter &filter, int w, int h) const;
+
+private:
+    int _width;
+    int _height;
+    unsigned int _aovs;
+    Image _images[AOV_COUNT];
+};
+
+#endif // FRAME_BUFFER_H
@@ -0,0 +1,79 @@
+#ifndef HALF_H
+#define HALF_H
+
+#include <cstdint>
+#include <cstring>
+
+// IEEE 754 binary16 conversions, for compact texel and pixel storage.
+
+// Rounds to nearest even; overflows to infinity, keeps NaN a NaN.
+inline uint16_t
+floatToHalf(float f)
+{
+    uint32_t x;
+    std::memcpy(&x, &f, 4);
+    const uint32_t sign = (x >> 16) & 0x8000u;
+    x &= 0x7fffffffu;
+
+    if (x >= 0x7f800000u) {
+        // infinity or NaN
+        return (uint16_t)(sign | 0x7c00u | (x > 0x7f800000u ? 0x200u : 0));
+    }
+    if (x >= 0x477ff000u) {
+        // rounds to a value above the largest half
+        return (uint16_t)(sign | 0x7c00u);
+    }
+    if (x < 0x38800000u) {
+        // subnormal half, or zero: align the mantissa to 2^-24 and round
+        if (x < 0x33000000u) {
+            return (uint16_t)sign;
+        }
+        const uint32_t e = x >> 23;
+        const uint32_t m = (x & 0x7fffffu) | 0x800000u;
+        const uint32_t shift = 126 - e;
+        uint32_t h = m >> shift;
+        const uint32_t rest = m & ((1u << shift) - 1);
+        const uint32_t halfway = 1u << (shift - 1);
+        if (rest > halfway || (rest == halfway && (h & 1))) {
+            ++h;
+        }
+        return (uint16_t)(sign | h);
+    }
+    // normal: rebias the exponent, round the mantissa to 10 bits
+    uint32_t h = ((x - 0x38000000u) >> 13);
+    const uint32_t rest = x & 0x1fffu;
+    if (rest > 0x1000u || (rest == 0x1000u && (h & 1))) {
+        ++h;
+    }
+    return (uint16_t)(sign | h);
+}
+
+inline float
+halfToFloat(uint16_t h)
+{
+    const uint32_t sign = (uint32_t)(h & 0x8000u) << 16;
+    const uint32_t e = (h >> 10) & 0x1fu;
+    const uint32_t m = h & 0x3ffu;
+    uint32_t x;
+    if (e == 0x1fu) {
+        x = sign | 0x7f800000u | (m << 13);
+    } else if (e != 0) {
+        x = sign | ((e + 112) << 23) | (m << 13);
+    } else if (m == 0) {
+        x = sign;
+    } else {
+        // subnormal half: normalize
+        int shift = 0;
+        uint32_t mm = m;
+        while (!(mm & 0x400u)) {
+            mm <<= 1;
+            ++shift;
+        }
+        x = sign | ((uint32_t)(113 - shift) << 23) | ((mm & 0x3ffu) << 13);
+    }
+    float f;
+    std::memcpy(&f, &x, 4);
+    return f;
+}
+
+#endif // HALF_H
@@ -4,95 +4,329 @@
 #include <cassert>
 
 #include "Image.h"
+#include "Parallel.h"
 
 #include "stb_image.h"
 #include "stb_image_write.h"
 
-static
-uint8_t
-clampColorComponent(float c)
+#include <VecmathSIMD.h>
+#if defined( VECMATH_SSE )
+#include <emmintrin.h>
+#endif
+
+#include <algorithm>
+#include <cmath>
+
+void
+Image::readRow(int y, float *r, float *g, float *b) const
 {
-    int tmp = int(c * 255);
+    assert(y >= 0 && y < _height);
+    float *out[3] = { r, g, b };
+    const size_t row = (size_t)y * _width;
+    for (int c = 0; c < 3; ++c) {
+        const uint8_t *plane = &_data[c * planeBytes()];
+        float *dst = out[c];
+        switch (_format) {
+        case FLOAT32:
+            memcpy(dst, plane + 4 * row, 4 * (size_t)_width);
+            break;
+        case FLOAT16: {
+            const uint16_t *src = (const uint16_t *)plane + row;
+            for (int x = 0; x < _width; ++x) {
+                dst[x] = halfToFloat(src[x]);
+            }
+            break;
+        }
+        case UINT8: {
+            const uint8_t *src = plane + row;
+            for (int x = 0; x < _width; ++x) {
+                dst[x] = src[x] / 255.0f;
+            }
+            break;
+        }
+        }
+    }
+}
 
-    if (tmp < 0) {
-        tmp = 0;
+void
+Image::writeRow(int y, const float *r, const float *g, const float *b)
+{
+    assert(y >= 0 && y < _height);
+    const float *in[3] = { r, g, b };
+    const size_t row = (size_t)y * _width;
+    for (int c = 0; c < 3; ++c) {
+        uint8_t *plane = &_data[c * planeBytes()];
+        const float *src = in[c];
+        switch (_format) {
+        case FLOAT32:
+            memcpy(plane + 4 * row, src, 4 * (size_t)_width);
+            break;
+        case FLOAT16: {
+            uint16_t *dst = (uint16_t *)plane + row;
+            for (int x = 0; x < _width; ++x) {
+                dst[x] = floatToHalf(src[x]);
+            }
+            break;
+        }
+        case UINT8: {
+            uint8_t *dst = plane + row;
+            for (int x = 0; x < _width; ++x) {
+                dst[x] = quantize(src[x]);
+            }
+            break;
+        }
+        }
     }
+}
 
-    if (tmp > 255) {
-        tmp = 255;
+Image
+Image::converted(Format format) const
+{
+    Image result(_width, _height, format);
+    std::vector<float> row(3 * (size_t)_width);
+    float *r = &row[0];
+    float *g = r + _width;
+    float *b = g + _width;
+    for (int y = 0; y < _height; ++y) {
+        readRow(y, r, g, b);
+        result.writeRow(y, r, g, b);
     }
+    return result;
+}
 
-    return uint8_t(tmp);
+// Quantizes n values of src to dst, as Image::quantize does.
+static void
+quantizeRow(const float *src, uint8_t *dst, int n)
+{
+    int i = 0;
+#if defined( VECMATH_SSE )
+    // truncate to int, then saturate to [0, 255] while packing down; out
+    // of range and NaN inputs convert to INT_MIN and end up 0, as int()
+    // gives on x86
+    const __m128 scale = _mm_set1_ps(255.0f);
+    for (; i + 16 <= n; i += 16) {
+        __m128i a = _mm_cvttps_epi32(_mm_mul_ps(_mm_loadu_ps(src + i), scale));
+        __m128i b = _mm_cvttps_epi32(_mm_mul_ps(_mm_loadu_ps(src + i + 4), scale));
+        __m128i c = _mm_cvttps_epi32(_mm_mul_ps(_mm_loadu_ps(src + i + 8), scale));
+        __m128i d = _mm_cvttps_epi32(_mm_mul_ps(_mm_loadu_ps(src + i + 12), scale));
+        __m128i packed = _mm_packus_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d));
+        _mm_storeu_si128((__m128i *)(dst + i), packed);
+    }
+#endif
+    for (; i < n; ++i) {
+        dst[i] = Image::quantize(src[i]);
+    }
+}
+
+std::vector<uint8_t>
+Image::quantizeRGB8() const
+{
+    std::vector<uint8_t> buffer(3 * (size_t)_width * _height);
+
+    // rows in blocks, so short rows still give each task some work
+    const int rowsPerTask = 16;
+    parallelFor(0, (_height + rowsPerTask - 1) / rowsPerTask, [&](int task) {
+        std::vector<uint8_t> planar(_format == UINT8 ? 0 : 3 * (size_t)_width);
+        std::vector<float> row(_format == FLOAT32 ? 0 : 3 * (size_t)_width);
+        const int end = std::min(_height, (task + 1) * rowsPerTask);
+        for (int y = task * rowsPerTask; y < end; ++y) {
+            const uint8_t *channel[3];
+            if (_format == UINT8) {
+                for (int c = 0; c < 3; ++c) {
+                    channel[c] = &_data[c * planeBytes() + (size_t)y * _width];
+                }
+            } else {
+                const float *values[3];
+                if (_format == FLOAT32) {
+                    for (int c = 0; c < 3; ++c) {
+                        values[c] = getRow(c, y);
+                    }
+                } else {
+                    readRow(y, &row[0], &row[_width], &row[2 * _width]);
+                    for (int c = 0; c < 3; ++c) {
+                        values[c] = &row[c * (size_t)_width];
+                    }
+                }
+                for (int c = 0; c < 3; ++c) {
+                    quantizeRow(values[c], &planar[c * (size_t)_width], _width);
+                    channel[c] = &planar[c * (size_t)_width];
+                }
+            }
+
+            // flip y so that (0,0) is bottom left corner
+            uint8_t *out = &buffer[3 * (size_t)(_height - 1 - y) * _width];
+            for (int x = 0; x < _width; x++) {
+                out[3 * x + 0] = channel[0][x];
+                out[3 * x + 1] = channel[1][x];
+                out[3 * x + 2] = channel[2][x];
+            }
+        }
+    });
+    return buffer;
+}
+
+void
+Image::setPNGCompression(int level)
+{
+    stbi_write_png_compression_level = level;
+}
+
+bool
+Image::writePNG(const std::string &filename, int w, int h, const std::vector<uint8_t> &rgb)
+{
+    assert(!filename.empty());
+    assert(rgb.size() == 3 * (size_t)w * h);
+    return stbi_write_png(filename.c_str(), w, h, 3, &rgb[0], w * 3) != 0;
 }
 
 void
 Image::savePNG(const std::string &filename) const
+{
+    writePNG(filename, _width, _height, quantizeRGB8());
+}
+
+Image 
+Image::loadPNG(const std::string &filename, Format format) 
 {
     assert(!filename.empty());
 
-    std::vector<uint8_t> buffer;
-    buffer.resize(_width * _height * 3);
+    int w, h, n;
+    unsigned char *buffer = stbi_load(filename.c_str(), &w, &h, &n, 3);
+    if (buffer == NULL) {
+        return Image();
+    }
 
-    // flip y so that (0,0) is bottom left corner
-    for (int c = 0, y = _height - 1; y >= 0; y--) {
-        for (int x = 0; x < _width; x++) {
-            const Vector3f &pixel = getPixel(x, y);
-            buffer[c++] = clampColorComponent(pixel[0]);
-            buffer[c++] = clampColorComponent(pixel[1]);
-            buffer[c++] = clampColorComponent(pixel[2]);
+    Image image(w, h, format);
+
+    // flip y so that (0,0) is bottom left corner, as savePNG writes it
+    std::vector<float> row(3 * (size_t)w);
+    float *r = &row[0];
+    float *g = r + w;
+    float *b = g + w;
+    for (int c = 0, y = h - 1; y >= 0; y--) {
+        for (int x = 0; x < w; x++) {
+            r[x] = buffer[c++] / 255.0f;
+            g[x] = buffer[c++] / 255.0f;
+            b[x] = buffer[c++] / 255.0f;
         }
+        image.writeRow(y, r, g, b);
     }
+    stbi_image_free(buffer);
 
-    stbi_write_png(filename.c_str(), _width, _height, 3, &buffer[0], _width * 3);
+    return image;
 }
 
-Image 
-Image::loadPNG(const std::string &filename) 
+static bool
+hostIsLittleEndian()
+{
+    const uint16_t one = 1;
+    uint8_t first;
+    memcpy(&first, &one, 1);
+    return first == 1;
+}
+
+bool
+Image::savePFM(const std::string &filename) const
 {
     assert(!filename.empty());
+    FILE *file = fopen(filename.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+    // a negative scale marks little-endian samples
+    fprintf(file, "PF\n%d %d\n%s\n", _width, _height, hostIsLittleEndian() ? "-1.0" : "1.0");
 
-    int w, h, n;
-    unsigned char *buffer = stbi_load(filename.c_str(), &w, &h, &n, 0);
-    assert(buffer != NULL);
-    assert(n == 3);
-
-    Image image(w, h);
-
-    // flip y so that (0,0) is bottom left corner
-    for (int c = 0, p = 0, y = h - 1; y >= 0; y--) {
-        for (int x = 0; x < w; x++, ++p) {
-            Vector3f &pixel = image._data[p];
-            pixel[0] = buffer[c++] / 255.0f;
-            pixel[1] = buffer[c++] / 255.0f;
-            pixel[2] = buffer[c++] / 255.0f;
+    std::vector<float> planar(3 * (size_t)_width);
+    std::vector<float> row(3 * (size_t)_width);
+    bool written = true;
+    for (int y = 0; y < _height && written; ++y) {
+        readRow(y, &planar[0], &planar[_width], &planar[2 * _width]);
+        for (int x = 0; x < _width; ++x) {
+            row[3 * x + 0] = planar[x];
+            row[3 * x + 1] = planar[_width + x];
+            row[3 * x + 2] = planar[2 * _width + x];
         }
+        written = fwrite(&row[0], sizeof(float), row.size(), file) == row.size();
     }
-    stbi_image_free(buffer);
+    return fclose(file) == 0 && written;
+}
+
+Image
+Image::loadPFM(const std::string &filename, Format format)
+{
+    FILE *file = fopen(filename.c_str(), "rb");
+    if (!file) {
+        return Image();
+    }
+    char type[3] = { 0 };
+    int w = 0, h = 0;
+    float scale = 0;
+    if (fscanf(file, "%2s %d %d %f", type, &w, &h, &scale) != 4 || fgetc(file) == EOF ||
+        (strcmp(type, "PF") && strcmp(type, "Pf")) || w <= 0 || h <= 0 || scale == 0) {
+        fclose(file);
+        return Image();
+    }
+    const int channels = type[1] == 'F' ? 3 : 1;
+    const bool swap = (scale < 0) != hostIsLittleEndian();
 
+    Image image(w, h, format);
+    std::vector<float> row(channels * (size_t)w);
+    std::vector<float> planar(3 * (size_t)w);
+    for (int y = 0; y < h; ++y) {
+        if (fread(&row[0], sizeof(float), row.size(), file) != row.size()) {
+            fclose(file);
+            return Image();
+        }
+        if (swap) {
+            for (float &v : row) {
+                uint8_t b[4];
+                memcpy(b, &v, 4);
+                std::swap(b[0], b[3]);
+                std::swap(b[1], b[2]);
+                memcpy(&v, b, 4);
+            }
+        }
+        for (int x = 0; x < w; ++x) {
+            for (int c = 0; c < 3; ++c) {
+                planar[c * (size_t)w + x] = row[channels * x + (channels == 3 ? c : 0)];
+            }
+        }
+        image.writeRow(y, &planar[0], &planar[w], &planar[2 * w]);
+    }
+    fclose(file);
     return image;
 }
 
+bool
+Image::isPFM(const std::string &filename)
+{
+    const size_t n = filename.size();
+    return n >= 4 && (filename.compare(n - 4, 4, ".pfm") == 0 || filename.compare(n - 4, 4, ".PFM") == 0);
+}
+
 Image
 Image::compare(const Image& img1, const Image & img2) 
 {
     assert(img1.getWidth() == img2.getWidth());
     assert(img1.getHeight() == img2.getHeight());
 
-    Image diff(img1.getWidth(), img1.getHeight());
-
     const int width = img1.getWidth();
     const int height = img1.getHeight();
-    for (int x = 0; x < width; x++) {
-        for (int y = 0; y < height; y++) {
-            const Vector3f &color1 = img1.getPixel(x, y);
-            const Vector3f &color2 = img2.getPixel(x, y);
-            Vector3f color3 =
-                Vector3f(fabs(color1[0] - color2[0]),
-                         fabs(color1[1] - color2[1]),
-                         fabs(color1[2] - color2[2]));
-            diff.setPixel(x, y, color3);
+    Image diff(width, height);
+
+    parallelFor(0, height, [&](int y) {
+        std::vector<float> row1(3 * (size_t)width), row2(3 * (size_t)width);
+        img1.readRow(y, &row1[0], &row1[width], &row1[2 * width]);
+        img2.readRow(y, &row2[0], &row2[width], &row2[2 * width]);
+        for (int c = 0; c < 3; ++c) {
+            const float *a = &row1[c * (size_t)width];
+            const float *b = &row2[c * (size_t)width];
+            float *d = diff.getRow(c, y);
+            for (int x = 0; x < width; x++) {
+                d[x] = std::fabs(a[x] - b[x]);
+            }
         }
-    }
+    });
 
     return diff;
 }
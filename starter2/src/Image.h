@@ -2,23 +2,41 @@
 #define IMAGE_H
 
 #include <cassert>
+#include <cstdint>
+#include <cstring>
 #include <string>
 #include <vector>
 
+#include "Half.h"
 #include "vecmath.h"
 
 // Simple image class
+//
+// Channels are stored as separate planes (all red values, then all green,
+// then all blue), each row contiguous, so passes over an image can stream
+// one channel at a time. Texels take 4, 2 or 1 bytes per channel:
+// FLOAT32 keeps values as they are, FLOAT16 rounds them to half floats,
+// and UINT8 quantizes them the way savePNG does, clamped to [0, 1].
+// Adding to a UINT8 pixel requantizes it, so such images should be
+// written once per pixel.
 class Image
 {
 public:
-    Image() : _width(0), _height(0) {}
+    enum Format {
+        FLOAT32,
+        FLOAT16,
+        UINT8,
+    };
+
+    Image() : _width(0), _height(0), _format(FLOAT32) {}
     // Instantiate an image of given width and height
     // All pixels are set to black (0, 0, 0) by default.
-    Image(int w, int h)
+    Image(int w, int h, Format format = FLOAT32)
     {
         _width = w;
         _height = h;
-        _data.resize(_width * _height);
+        _format = format;
+        _data.resize(3 * planeBytes());
     }
 
     // Return width of image
@@ -31,40 +49,154 @@ public:
         return _height;
     }
 
+    Format getFormat() const {
+        return _format;
+    }
+
     // Set pixel to given RGB
     void setPixel(int x, int y, const Vector3f &color) {
         assert(x >= 0 && x < _width);
         assert(y >= 0 && y < _height);
-        _data[y * _width + x] = color;
+        const size_t i = (size_t)y * _width + x;
+        for (int c = 0; c < 3; ++c) {
+            store(c, i, color[c]);
+        }
     }
 
     // Return pixel at given x, y coordinates
-    const Vector3f & getPixel(int x, int y) const {
+    Vector3f getPixel(int x, int y) const {
         assert(x >= 0 && x < _width);
         assert(y >= 0 && y < _height);
-        return _data[y * _width + x];
+        const size_t i = (size_t)y * _width + x;
+        return Vector3f(load(0, i), load(1, i), load(2, i));
+    }
+
+    // Row y of channel c of a FLOAT32 image (width values).
+    const float * getRow(int c, int y) const {
+        assert(_format == FLOAT32);
+        assert(c >= 0 && c < 3 && y >= 0 && y < _height);
+        return (const float *)&_data[c * planeBytes()] + (size_t)y * _width;
+    }
+
+    float * getRow(int c, int y) {
+        assert(_format == FLOAT32);
+        assert(c >= 0 && c < 3 && y >= 0 && y < _height);
+        return (float *)&_data[c * planeBytes()] + (size_t)y * _width;
     }
 
+    // Copies row y of any format to or from width floats per channel.
+    void readRow(int y, float *r, float *g, float *b) const;
+    void writeRow(int y, const float *r, const float *g, const float *b);
+
     // Initialize all pixels in image to given RGB color.
     void setAllPixels(const Vector3f &color) {
-        for (int i = 0; i < _width * _height; ++i) {
-            _data[i] = color;
+        for (int y = 0; y < _height; ++y) {
+            for (int x = 0; x < _width; ++x) {
+                setPixel(x, y, color);
+            }
         }
     }
 
-    // Reads PNG image and return new image instance.
-    static Image loadPNG(const std::string &filename);
+    // A copy of the image stored in another format.
+    Image converted(Format format) const;
+
+    // Reads PNG image and return new image instance (empty if the file
+    // cannot be read). Alpha is dropped and grey is expanded to RGB.
+    static Image loadPNG(const std::string &filename, Format format = FLOAT32);
 
     // Save contents of image to given file name in PNG file format.
     void savePNG(const std::string &filename) const;
 
-    // Return an absolute difference betweenthe given images
+    // The 8-bit RGB pixels savePNG writes, top row first. Rows are
+    // quantized in parallel, with SSE when vecmath is built with
+    // VECMATH_SIMD.
+    std::vector<uint8_t> quantizeRGB8() const;
+
+    // Encodes quantizeRGB8() output of a w x h image to a PNG file.
+    // Returns false if the file could not be written.
+    static bool writePNG(const std::string &filename, int w, int h,
+                         const std::vector<uint8_t> &rgb);
+
+    // Deflate level of every PNG written from now on (default 8; higher
+    // is smaller and slower, levels under 5 act as 5). Call it before
+    // starting any writes.
+    static void setPNGCompression(int level);
+
+    // Save the image as linear floats in Portable Float Map format (PF,
+    // RGB), bottom row first, in the host's byte order as the format
+    // allows. Returns false if the file could not be written.
+    bool savePFM(const std::string &filename) const;
+
+    // Reads a PF (RGB) or Pf (greyscale) file in either byte order.
+    // Returns an empty image if the file cannot be read.
+    static Image loadPFM(const std::string &filename, Format format = FLOAT32);
+
+    // True if filename ends in .pfm, the extension the renderer writes
+    // float maps for.
+    static bool isPFM(const std::string &filename);
+
+    // Return an absolute difference betweenthe given images. See
+    // ImageCompare for error metrics.
     static Image compare(const Image & img1, const Image & img2);
 
+    // The 8-bit value savePNG writes for c.
+    static uint8_t quantize(float c) {
+        int tmp = int(c * 255);
+        if (tmp < 0) {
+            tmp = 0;
+        }
+        if (tmp > 255) {
+            tmp = 255;
+        }
+        return uint8_t(tmp);
+    }
+
 private:
+    size_t planeBytes() const {
+        static const size_t bytes[3] = { 4, 2, 1 };
+        return (size_t)_width * _height * bytes[_format];
+    }
+
+    void store(int c, size_t i, float v) {
+        uint8_t *plane = &_data[c * planeBytes()];
+        switch (_format) {
+        case FLOAT32:
+            memcpy(plane + 4 * i, &v, 4);
+            break;
+        case FLOAT16: {
+            uint16_t h = floatToHalf(v);
+            memcpy(plane + 2 * i, &h, 2);
+            break;
+        }
+        case UINT8:
+            plane[i] = quantize(v);
+            break;
+        }
+    }
+
+    float load(int c, size_t i) const {
+        const uint8_t *plane = &_data[c * planeBytes()];
+        switch (_format) {
+        case FLOAT32: {
+            float v;
+            memcpy(&v, plane + 4 * i, 4);
+            return v;
+        }
+        case FLOAT16: {
+            uint16_t h;
+            memcpy(&h, plane + 2 * i, 2);
+            return halfToFloat(h);
+        }
+        case UINT8:
+            break;
+        }
+        return plane[i] / 255.0f;
+    }
+
     int _width;
     int _height;
-    std::vector<Vector3f> _data;
+    Format _format;
+    std::vector<uint8_t> _data;
 };
 
 #endif // IMAGE_H
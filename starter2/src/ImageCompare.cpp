@@ -0,0 +1,208 @@
+#include "ImageCompare.h"
+#include "Parallel.h"
+
+#include <VecmathSIMD.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+// Abs difference of n values into d (may be null); returns the largest and
+// adds the sum and the sum of squares.
+static float
+diffRow(const float *a, const float *b, float *d, int n, double &sum, double &sumSquares)
+{
+    int i = 0;
+    float largest = 0;
+    float s = 0;
+    float s2 = 0;
+#if defined( VECMATH_SSE )
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    __m128 vmax = _mm_setzero_ps();
+    __m128 vsum = _mm_setzero_ps();
+    __m128 vsum2 = _mm_setzero_ps();
+    for (; i + 4 <= n; i += 4) {
+        __m128 e = _mm_andnot_ps(sign, _mm_sub_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+        if (d) {
+            _mm_storeu_ps(d + i, e);
+        }
+        vmax = _mm_max_ps(vmax, e);
+        vsum = _mm_add_ps(vsum, e);
+        vsum2 = _mm_add_ps(vsum2, _mm_mul_ps(e, e));
+    }
+    alignas(16) float lanes[3][4];
+    _mm_store_ps(lanes[0], vmax);
+    _mm_store_ps(lanes[1], vsum);
+    _mm_store_ps(lanes[2], vsum2);
+    for (int k = 0; k < 4; ++k) {
+        largest = std::max(largest, lanes[0][k]);
+        s += lanes[1][k];
+        s2 += lanes[2][k];
+    }
+#endif
+    for (; i < n; ++i) {
+        float e = std::fabs(a[i] - b[i]);
+        if (d) {
+            d[i] = e;
+        }
+        largest = std::max(largest, e);
+        s += e;
+        s2 += e * e;
+    }
+    sum += s;
+    sumSquares += s2;
+    return largest;
+}
+
+// Separable Gaussian blur of a w x h single-channel map, clamping at the
+// borders.
+static void
+blur(const std::vector<float> &src, std::vector<float> &dst, int w, int h,
+     const float *kernel, int radius)
+{
+    std::vector<float> tmp(src.size());
+    parallelFor(0, h, [&](int y) {
+        const float *row = &src[(size_t)y * w];
+        float *out = &tmp[(size_t)y * w];
+        for (int x = 0; x < w; ++x) {
+            float v = 0;
+            for (int k = -radius; k <= radius; ++k) {
+                v += kernel[k + radius] * row[std::min(std::max(x + k, 0), w - 1)];
+            }
+            out[x] = v;
+        }
+    });
+    dst.resize(src.size());
+    parallelFor(0, h, [&](int y) {
+        float *out = &dst[(size_t)y * w];
+        std::fill(out, out + w, 0.0f);
+        for (int k = -radius; k <= radius; ++k) {
+            const float *row = &tmp[(size_t)std::min(std::max(y + k, 0), h - 1) * w];
+            const float weight = kernel[k + radius];
+            for (int x = 0; x < w; ++x) {
+                out[x] += weight * row[x];
+            }
+        }
+    });
+}
+
+static double
+structuralSimilarity(const Image &test, const Image &reference)
+{
+    const int w = test.getWidth();
+    const int h = test.getHeight();
+    const size_t n = (size_t)w * h;
+
+    // luminance, and the products the local statistics need
+    std::vector<float> x(n), y(n), xx(n), yy(n), xy(n);
+    parallelFor(0, h, [&](int row) {
+        std::vector<float> a(3 * w), b(3 * w);
+        test.readRow(row, &a[0], &a[w], &a[2 * w]);
+        reference.readRow(row, &b[0], &b[w], &b[2 * w]);
+        for (int i = 0; i < w; ++i) {
+            const size_t p = (size_t)row * w + i;
+            x[p] = 0.2126f * a[i] + 0.7152f * a[w + i] + 0.0722f * a[2 * w + i];
+            y[p] = 0.2126f * b[i] + 0.7152f * b[w + i] + 0.0722f * b[2 * w + i];
+            xx[p] = x[p] * x[p];
+            yy[p] = y[p] * y[p];
+            xy[p] = x[p] * y[p];
+        }
+    });
+
+    const int radius = 5;
+    float kernel[2 * radius + 1];
+    float total = 0;
+    for (int k = -radius; k <= radius; ++k) {
+        kernel[k + radius] = std::exp(-k * k / (2 * 1.5f * 1.5f));
+        total += kernel[k + radius];
+    }
+    for (float &k : kernel) {
+        k /= total;
+    }
+    std::vector<float> mx, my, mxx, myy, mxy;
+    blur(x, mx, w, h, kernel, radius);
+    blur(y, my, w, h, kernel, radius);
+    blur(xx, mxx, w, h, kernel, radius);
+    blur(yy, myy, w, h, kernel, radius);
+    blur(xy, mxy, w, h, kernel, radius);
+
+    const double c1 = 0.01 * 0.01;
+    const double c2 = 0.03 * 0.03;
+    std::vector<double> rows(h);
+    parallelFor(0, h, [&](int row) {
+        double s = 0;
+        for (int i = 0; i < w; ++i) {
+            const size_t p = (size_t)row * w + i;
+            const double ux = mx[p];
+            const double uy = my[p];
+            const double vx = mxx[p] - ux * ux;
+            const double vy = myy[p] - uy * uy;
+            const double cxy = mxy[p] - ux * uy;
+            s += ((2 * ux * uy + c1) * (2 * cxy + c2)) /
+                ((ux * ux + uy * uy + c1) * (vx + vy + c2));
+        }
+        rows[row] = s;
+    });
+    double sum = 0;
+    for (double s : rows) {
+        sum += s;
+    }
+    return sum / n;
+}
+
+void
+ImageCompare::compare(const Image &test, const Image &reference,
+                      ImageMetrics &metrics, Image *diff)
+{
+    assert(test.getWidth() == reference.getWidth());
+    assert(test.getHeight() == reference.getHeight());
+    const int w = test.getWidth();
+    const int h = test.getHeight();
+    if (diff) {
+        *diff = Image(w, h);
+    }
+
+    // per-row results, summed in row order afterwards
+    std::vector<float> rowMax(h);
+    std::vector<double> rowSum(h), rowSquares(h);
+    parallelFor(0, h, [&](int y) {
+        std::vector<float> a(3 * w), b(3 * w);
+        test.readRow(y, &a[0], &a[w], &a[2 * w]);
+        reference.readRow(y, &b[0], &b[w], &b[2 * w]);
+        double sum = 0, squares = 0;
+        float largest = 0;
+        for (int c = 0; c < 3; ++c) {
+            float *d = diff ? diff->getRow(c, y) : nullptr;
+            largest = std::max(largest, diffRow(&a[c * w], &b[c * w], d, w, sum, squares));
+        }
+        rowMax[y] = largest;
+        rowSum[y] = sum;
+        rowSquares[y] = squares;
+    });
+
+    double sum = 0, squares = 0;
+    float largest = 0;
+    for (int y = 0; y < h; ++y) {
+        largest = std::max(largest, rowMax[y]);
+        sum += rowSum[y];
+        squares += rowSquares[y];
+    }
+    const double n = 3.0 * w * h;
+    metrics.maxError = largest;
+    metrics.meanError = n > 0 ? (float)(sum / n) : 0.0f;
+    metrics.mse = n > 0 ? squares / n : 0.0;
+    metrics.psnr = metrics.mse > 0 ? 10 * std::log10(1 / metrics.mse)
+                                   : std::numeric_limits<double>::infinity();
+    metrics.ssim = n > 0 ? structuralSimilarity(test, reference) : 1.0;
+}
+
+Image
+ImageCompare::load(const std::string &filename)
+{
+    if (Image::isPFM(filename)) {
+        return Image::loadPFM(filename);
+    }
+    return Image::loadPNG(filename);
+}
@@ -0,0 +1,36 @@
+#ifndef IMAGE_COMPARE_H
+#define IMAGE_COMPARE_H
+
+#include "Image.h"
+
+// Error metrics between a test image and a reference of the same size,
+// for regression gates. Errors are over all three channels, with values
+// taken as they are (1 is full scale).
+struct ImageMetrics
+{
+    float maxError;
+    float meanError;
+    double mse;
+    // 10 log10(1 / mse) in dB; infinite for identical images
+    double psnr;
+    // mean structural similarity of the luminance, with the usual 11x11
+    // Gaussian window (sigma 1.5); 1 for identical images
+    double ssim;
+};
+
+class ImageCompare
+{
+public:
+    // Fills metrics and, if diff is given, sets it to the per-channel
+    // absolute difference. Rows are processed in parallel, several
+    // pixels at a time with SSE when vecmath is built with VECMATH_SIMD;
+    // results do not depend on the thread count.
+    static void compare(const Image &test, const Image &reference,
+                        ImageMetrics &metrics, Image *diff = nullptr);
+
+    // Loads a PNG or PFM (by extension). Returns an empty image if the
+    // file cannot be read.
+    static Image load(const std::string &filename);
+};
+
+#endif // IMAGE_COMPARE_H
@@ -0,0 +1,78 @@
+#include "ImageWriter.h"
+#include "Image.h"
+
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <utility>
+
+template<typename F>
+void
+ImageWriter::submit(const std::string &filename, const F &write)
+{
+    // forget finished jobs, and find the last one still writing filename
+    std::shared_future<void> previous;
+    std::vector<Job> pending;
+    for (Job &job : _jobs) {
+        if (job.done.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+            continue;
+        }
+        if (job.filename == filename) {
+            previous = job.done;
+        }
+        pending.push_back(std::move(job));
+    }
+    _jobs.swap(pending);
+
+    Job job;
+    job.filename = filename;
+    job.done = std::async(std::launch::async, [filename, previous, write]() {
+        if (previous.valid()) {
+            previous.wait();
+        }
+        if (!write()) {
+            printf("Error: could not write %s\n", filename.c_str());
+        }
+    }).share();
+    _jobs.push_back(job);
+}
+
+void
+ImageWriter::savePNG(const Image &image, const std::string &filename)
+{
+    const int w = image.getWidth();
+    const int h = image.getHeight();
+    std::shared_ptr<std::vector<uint8_t> > rgb =
+        std::make_shared<std::vector<uint8_t> >(image.quantizeRGB8());
+    submit(filename, [filename, w, h, rgb]() {
+        return Image::writePNG(filename, w, h, *rgb);
+    });
+}
+
+void
+ImageWriter::savePFM(const Image &image, const std::string &filename)
+{
+    std::shared_ptr<Image> copy = std::make_shared<Image>(image);
+    submit(filename, [filename, copy]() {
+        return copy->savePFM(filename);
+    });
+}
+
+void
+ImageWriter::save(const Image &image, const std::string &filename)
+{
+    if (Image::isPFM(filename)) {
+        savePFM(image, filename);
+    } else {
+        savePNG(image, filename);
+    }
+}
+
+void
+ImageWriter::wait()
+{
+    for (Job &job : _jobs) {
+        job.done.wait();
+    }
+    _jobs.clear();
+}
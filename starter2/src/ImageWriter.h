@@ -0,0 +1,52 @@
+#ifndef IMAGE_WRITER_H
+#define IMAGE_WRITER_H
+
+#include <future>
+#include <string>
+#include <vector>
+
+class Image;
+
+// Writes image files on background threads, so deflating one image
+// overlaps with rendering or with writing the others.
+//
+// An image is quantized (PNG) or copied (PFM) when it is handed over, so
+// the caller may change or free it right away; only the encoding and the
+// file write are deferred. Writes to the same file land in the order they
+// were asked for.
+class ImageWriter
+{
+public:
+    ImageWriter() {}
+    ~ImageWriter() { wait(); }
+
+    ImageWriter(const ImageWriter &) = delete;
+    ImageWriter &operator=(const ImageWriter &) = delete;
+
+    void savePNG(const Image &image, const std::string &filename);
+
+    // Writes a copy of image as a float map; no quantization or deflate.
+    void savePFM(const Image &image, const std::string &filename);
+
+    // savePFM for .pfm file names, savePNG otherwise.
+    void save(const Image &image, const std::string &filename);
+
+    // Blocks until every write has finished.
+    void wait();
+
+private:
+    // Runs write on a background thread after any pending write to
+    // filename.
+    template<typename F>
+    void submit(const std::string &filename, const F &write);
+
+    struct Job
+    {
+        std::string filename;
+        std::shared_future<void> done;
+    };
+
+    std::vector<Job> _jobs;
+};
+
+#endif // IMAGE_WRITER_H
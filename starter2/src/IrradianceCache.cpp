@@ -0,0 +1,153 @@
+#include "IrradianceCache.h"
+
+#include <algorithm>
+#include <cmath>
+
+// deepest octree level records are placed in
+static const int maxDepth = 20;
+
+IrradianceCache::IrradianceCache(float maxError) :
+    _maxError(maxError)
+{
+    reset(Vector3f(-1), Vector3f(1));
+}
+
+void
+IrradianceCache::reset(const Vector3f &lo, const Vector3f &hi)
+{
+    _records.clear();
+    _nodes.clear();
+
+    // a cube, so every level has cubic nodes
+    Vector3f center = 0.5f * (lo + hi);
+    float half = 0.5f * std::max(hi[0] - lo[0], std::max(hi[1] - lo[1], hi[2] - lo[2]));
+    half = std::max(half, 1e-4f) * 1.01f;
+
+    Node root;
+    root.lo = center - Vector3f(half);
+    root.hi = center + Vector3f(half);
+    std::fill(root.child, root.child + 8, -1);
+    _nodes.push_back(root);
+}
+
+int
+IrradianceCache::child(int node, int c)
+{
+    if (_nodes[node].child[c] < 0) {
+        const Vector3f lo = _nodes[node].lo;
+        const Vector3f hi = _nodes[node].hi;
+        const Vector3f mid = 0.5f * (lo + hi);
+        Node n;
+        for (int a = 0; a < 3; ++a) {
+            bool upper = (c >> a) & 1;
+            n.lo[a] = upper ? mid[a] : lo[a];
+            n.hi[a] = upper ? hi[a] : mid[a];
+        }
+        std::fill(n.child, n.child + 8, -1);
+        _nodes.push_back(n);
+        _nodes[node].child[c] = (int)_nodes.size() - 1;
+    }
+    return _nodes[node].child[c];
+}
+
+void
+IrradianceCache::insert(const IrradianceRecord &record)
+{
+    const int index = (int)_records.size();
+    _records.push_back(record);
+
+    // the record can only be valid within maxError * radius of its position
+    const float reach = _maxError * record.radius;
+    const float rootSize = _nodes[0].hi[0] - _nodes[0].lo[0];
+    int level = 0;
+    while (level < maxDepth && rootSize / (float)(1 << (level + 1)) >= 2 * reach) {
+        ++level;
+    }
+    insert(0, index, record.position - Vector3f(reach), record.position + Vector3f(reach), level, 0);
+}
+
+void
+IrradianceCache::insert(int node, int record, const Vector3f &lo, const Vector3f &hi,
+                        int level, int depth)
+{
+    if (depth == level) {
+        _nodes[node].records.push_back(record);
+        return;
+    }
+    const Vector3f mid = 0.5f * (_nodes[node].lo + _nodes[node].hi);
+    for (int c = 0; c < 8; ++c) {
+        bool overlaps = true;
+        for (int a = 0; a < 3; ++a) {
+            bool upper = (c >> a) & 1;
+            overlaps = overlaps && (upper ? hi[a] >= mid[a] : lo[a] <= mid[a]);
+        }
+        if (overlaps) {
+            insert(child(node, c), record, lo, hi, level, depth + 1);
+        }
+    }
+}
+
+void
+IrradianceCache::gather(const IrradianceRecord &r, const Vector3f &p, const Vector3f &n,
+                        float error, Vector3f &sum, float &weightSum)
+{
+    const Vector3f d = p - r.position;
+    float e = d.abs() / r.radius +
+        std::sqrt(std::max(0.0f, 1.0f - Vector3f::dot(n, r.normal)));
+    if (e >= error) {
+        return;
+    }
+    // a record in front of p sees occluders p does not
+    if (Vector3f::dot(d, r.normal + n) < -0.1f * error * r.radius) {
+        return;
+    }
+
+    const Vector3f axis = Vector3f::cross(r.normal, n);
+    Vector3f irradiance;
+    for (int c = 0; c < 3; ++c) {
+        irradiance[c] = std::max(0.0f, r.irradiance[c] +
+            Vector3f::dot(r.rotGradient[c], axis) + Vector3f::dot(r.transGradient[c], d));
+    }
+    float w = 1.0f / std::max(e, 1e-4f);
+    sum += w * irradiance;
+    weightSum += w;
+}
+
+void
+IrradianceCache::gather(const Vector3f &p, const Vector3f &n, float error,
+                        Vector3f &sum, float &weightSum) const
+{
+    int node = 0;
+    for (;;) {
+        const Node &nd = _nodes[node];
+        for (int i : nd.records) {
+            gather(_records[i], p, n, error, sum, weightSum);
+        }
+        const Vector3f mid = 0.5f * (nd.lo + nd.hi);
+        int c = 0;
+        for (int a = 0; a < 3; ++a) {
+            if (p[a] < nd.lo[a] || p[a] > nd.hi[a]) {
+                return;
+            }
+            c |= (p[a] >= mid[a]) << a;
+        }
+        if (nd.child[c] < 0) {
+            return;
+        }
+        node = nd.child[c];
+    }
+}
+
+bool
+IrradianceCache::lookup(const Vector3f &p, const Vector3f &n, float error,
+                        Vector3f &irradiance) const
+{
+    Vector3f sum = Vector3f::ZERO;
+    float weightSum = 0;
+    gather(p, n, error, sum, weightSum);
+    if (weightSum <= 0) {
+        return false;
+    }
+    irradiance = sum / weightSum;
+    return true;
+}
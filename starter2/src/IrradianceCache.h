@@ -0,0 +1,77 @@
+#ifndef IRRADIANCE_CACHE_H
+#define IRRADIANCE_CACHE_H
+
+#include <Vector3f.h>
+
+#include <vector>
+
+// Diffuse indirect irradiance sampled at one surface point, with the
+// gradients used to extrapolate it to nearby points and normals (Ward and
+// Heckbert, "Irradiance Gradients", 1992). Irradiance is stored divided
+// by pi, so a surface with diffuse color kd reflects kd * irradiance.
+struct IrradianceRecord
+{
+    Vector3f position;
+    Vector3f normal;
+    float radius;               // harmonic mean distance to the surroundings, clamped
+    Vector3f irradiance;
+    Vector3f rotGradient[3];    // per channel, change with rotation of the normal
+    Vector3f transGradient[3];  // per channel, change with position
+};
+
+// Sparse irradiance records in an octree. A record is valid at (p, n) if
+// Ward's error estimate
+//     |p - position| / radius + sqrt(1 - n . normal)
+// is below the lookup's error bound; valid records are blended with
+// weight 1 / error, each extrapolated with its gradients.
+//
+// Records are placed in the octree level whose nodes are just large
+// enough to hold the region a record can be valid in, and in every node
+// of that level overlapping it, so a lookup only walks the nodes on the
+// path from the root to p. Lookups are read-only and may run
+// concurrently; insert may not run alongside them.
+class IrradianceCache
+{
+public:
+    // maxError bounds the error of every lookup.
+    IrradianceCache(float maxError = 0.3f);
+
+    // Bounds of the points that will be looked up; clears the cache.
+    void reset(const Vector3f &lo, const Vector3f &hi);
+
+    void insert(const IrradianceRecord &record);
+
+    int size() const { return (int)_records.size(); }
+
+    // Adds the extrapolated irradiance of every record valid at (p, n)
+    // within error, times its weight, to sum, and the weight to weightSum.
+    void gather(const Vector3f &p, const Vector3f &n, float error,
+                Vector3f &sum, float &weightSum) const;
+
+    static void gather(const IrradianceRecord &r, const Vector3f &p, const Vector3f &n,
+                       float error, Vector3f &sum, float &weightSum);
+
+    // Interpolated irradiance at (p, n); false if no record is valid.
+    bool lookup(const Vector3f &p, const Vector3f &n, float error,
+                Vector3f &irradiance) const;
+
+    float getMaxError() const { return _maxError; }
+
+private:
+    struct Node
+    {
+        Vector3f lo, hi;
+        int child[8];           // -1 where not created yet
+        std::vector<int> records;
+    };
+
+    int child(int node, int c);
+
+    void insert(int node, int record, const Vector3f &lo, const Vector3f &hi, int level, int depth);
+
+    float _maxError;
+    std::vector<Node> _nodes;
+    std::vector<IrradianceRecord> _records;
+};
+
+#endif // IRRADIANCE_CACHE_H
@@ -0,0 +1,206 @@
+#include "LayerFile.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+static const char layerMagic[8] = { 'L', 'A', 'Y', 'E', 'R', 'S', '1', 0 };
+static const int nameBytes = 32;
+
+static bool
+hostIsLittleEndian()
+{
+    const uint16_t one = 1;
+    uint8_t first;
+    memcpy(&first, &one, 1);
+    return first == 1;
+}
+
+// Reverses each size-byte value of data on big-endian hosts, so files
+// are little-endian either way.
+static void
+toLittleEndian(void *data, size_t count, size_t size)
+{
+    if (hostIsLittleEndian()) {
+        return;
+    }
+    uint8_t *bytes = (uint8_t *)data;
+    for (size_t i = 0; i < count; ++i) {
+        std::reverse(bytes + i * size, bytes + (i + 1) * size);
+    }
+}
+
+static bool
+writeUint32(FILE *file, uint32_t v)
+{
+    toLittleEndian(&v, 1, 4);
+    return fwrite(&v, 4, 1, file) == 1;
+}
+
+static bool
+readUint32(FILE *file, uint32_t &v)
+{
+    if (fread(&v, 4, 1, file) != 1) {
+        return false;
+    }
+    toLittleEndian(&v, 1, 4);
+    return true;
+}
+
+// True if layers can go in one file: at least one, all of one size, each
+// with 1 or 3 channels.
+static bool
+validLayers(const std::vector<LayerFile::Layer> &layers)
+{
+    if (layers.empty()) {
+        return false;
+    }
+    for (const LayerFile::Layer &layer : layers) {
+        if (layer.image->getWidth() != layers[0].image->getWidth() ||
+            layer.image->getHeight() != layers[0].image->getHeight() ||
+            (layer.channels != 1 && layer.channels != 3)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool
+LayerFile::write(const std::string &filename, const std::vector<Layer> &layers,
+                 Image::Format sampleFormat, int tileSize)
+{
+    assert(sampleFormat == Image::FLOAT32 || sampleFormat == Image::FLOAT16);
+    assert(tileSize > 0);
+    if (!validLayers(layers)) {
+        return false;
+    }
+    const int w = layers[0].image->getWidth();
+    const int h = layers[0].image->getHeight();
+    const size_t sampleBytes = sampleFormat == Image::FLOAT32 ? 4 : 2;
+
+    FILE *file = fopen(filename.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+    bool written = fwrite(layerMagic, sizeof(layerMagic), 1, file) == 1 &&
+        writeUint32(file, w) && writeUint32(file, h) && writeUint32(file, tileSize) &&
+        writeUint32(file, (uint32_t)sampleBytes) && writeUint32(file, (uint32_t)layers.size());
+    for (const Layer &layer : layers) {
+        char name[nameBytes] = { 0 };
+        strncpy(name, layer.name.c_str(), nameBytes - 1);
+        written = written && fwrite(name, nameBytes, 1, file) == 1 &&
+            writeUint32(file, layer.channels);
+    }
+
+    // one row of tiles of every layer, as planar float rows
+    std::vector<std::vector<float> > band(layers.size());
+    for (size_t l = 0; l < layers.size(); ++l) {
+        band[l].resize(3 * (size_t)w * tileSize);
+    }
+    std::vector<uint8_t> tile;
+    for (int y0 = 0; y0 < h && written; y0 += tileSize) {
+        const int th = std::min(tileSize, h - y0);
+        for (size_t l = 0; l < layers.size(); ++l) {
+            for (int y = 0; y < th; ++y) {
+                float *row = &band[l][3 * (size_t)w * y];
+                layers[l].image->readRow(y0 + y, row, row + w, row + 2 * w);
+            }
+        }
+        for (int x0 = 0; x0 < w && written; x0 += tileSize) {
+            const int tw = std::min(tileSize, w - x0);
+            tile.clear();
+            for (size_t l = 0; l < layers.size(); ++l) {
+                for (int c = 0; c < layers[l].channels; ++c) {
+                    for (int y = 0; y < th; ++y) {
+                        const float *src = &band[l][3 * (size_t)w * y + (size_t)c * w + x0];
+                        const size_t at = tile.size();
+                        tile.resize(at + tw * sampleBytes);
+                        if (sampleFormat == Image::FLOAT32) {
+                            memcpy(&tile[at], src, tw * sampleBytes);
+                        } else {
+                            for (int x = 0; x < tw; ++x) {
+                                uint16_t half = floatToHalf(src[x]);
+                                memcpy(&tile[at + 2 * x], &half, 2);
+                            }
+                        }
+                    }
+                }
+            }
+            toLittleEndian(&tile[0], tile.size() / sampleBytes, sampleBytes);
+            written = fwrite(&tile[0], 1, tile.size(), file) == tile.size();
+        }
+    }
+    return fclose(file) == 0 && written;
+}
+
+bool
+LayerFile::read(const std::string &filename, std::vector<std::string> &names,
+                std::vector<Image> &images)
+{
+    FILE *file = fopen(filename.c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+    char magic[sizeof(layerMagic)];
+    uint32_t w, h, tileSize, sampleBytes, count;
+    bool valid = fread(magic, sizeof(magic), 1, file) == 1 &&
+        memcmp(magic, layerMagic, sizeof(magic)) == 0 &&
+        readUint32(file, w) && readUint32(file, h) && readUint32(file, tileSize) &&
+        readUint32(file, sampleBytes) && readUint32(file, count) &&
+        w > 0 && h > 0 && tileSize > 0 && (sampleBytes == 4 || sampleBytes == 2) && count > 0;
+    std::vector<uint32_t> channels;
+    names.clear();
+    for (uint32_t l = 0; valid && l < count; ++l) {
+        char name[nameBytes];
+        uint32_t c;
+        valid = fread(name, nameBytes, 1, file) == 1 && readUint32(file, c) && (c == 1 || c == 3);
+        name[nameBytes - 1] = 0;
+        names.push_back(name);
+        channels.push_back(c);
+    }
+    if (!valid) {
+        fclose(file);
+        return false;
+    }
+
+    images.assign(count, Image(w, h));
+    std::vector<uint8_t> block;
+    for (uint32_t y0 = 0; y0 < h && valid; y0 += tileSize) {
+        const uint32_t th = std::min(tileSize, h - y0);
+        for (uint32_t x0 = 0; x0 < w && valid; x0 += tileSize) {
+            const uint32_t tw = std::min(tileSize, w - x0);
+            for (uint32_t l = 0; l < count && valid; ++l) {
+                for (uint32_t c = 0; c < channels[l] && valid; ++c) {
+                    block.resize((size_t)tw * th * sampleBytes);
+                    valid = fread(&block[0], 1, block.size(), file) == block.size();
+                    toLittleEndian(&block[0], (size_t)tw * th, sampleBytes);
+                    for (uint32_t y = 0; valid && y < th; ++y) {
+                        for (uint32_t x = 0; x < tw; ++x) {
+                            const size_t i = (size_t)y * tw + x;
+                            float v;
+                            if (sampleBytes == 4) {
+                                memcpy(&v, &block[4 * i], 4);
+                            } else {
+                                uint16_t half;
+                                memcpy(&half, &block[2 * i], 2);
+                                v = halfToFloat(half);
+                            }
+                            if (channels[l] == 3) {
+                                images[l].getRow(c, y0 + y)[x0 + x] = v;
+                                continue;
+                            }
+                            // single-channel layers fill all three
+                            for (int k = 0; k < 3; ++k) {
+                                images[l].getRow(k, y0 + y)[x0 + x] = v;
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+    fclose(file);
+    return valid;
+}
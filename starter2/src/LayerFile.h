@@ -0,0 +1,52 @@
+#ifndef LAYER_FILE_H
+#define LAYER_FILE_H
+
+#include "Image.h"
+
+#include <string>
+#include <vector>
+
+// Multi-layer float image file: several images of one frame (color,
+// normal, depth, ...) kept together as linear samples, for compositing
+// without the quantization and deflate of PNG.
+//
+// Layout, all integers and samples little-endian:
+//   char     magic[8]         "LAYERS1\0"
+//   uint32   width, height
+//   uint32   tileSize         tiles are tileSize x tileSize pixels
+//   uint32   sampleBytes      4 (float32) or 2 (float16)
+//   uint32   layerCount
+//   layerCount times:
+//     char   name[32]         zero padded
+//     uint32 channels         1 (the red channel only) or 3 (RGB)
+//   tiles, row by row of tiles starting at the bottom of the image; edge
+//   tiles are cropped to the image. Each tile holds every channel of
+//   every layer in turn, each as a block of the tile's pixels, bottom row
+//   first.
+//
+// Tiles let a reader pull out a region of every layer with a few reads.
+class LayerFile
+{
+public:
+    struct Layer
+    {
+        std::string name;
+        int channels;
+        const Image *image;
+    };
+
+    // Writes the layers (all of one size) in one pass, reading tileSize
+    // rows of each layer at a time. sampleFormat is FLOAT32, or FLOAT16
+    // for half the size. Returns false if the file could not be written,
+    // or if the layers differ in size or have other than 1 or 3 channels.
+    static bool write(const std::string &filename, const std::vector<Layer> &layers,
+                      Image::Format sampleFormat = Image::FLOAT32, int tileSize = 64);
+
+    // Reads every layer of a file written by write, as FLOAT32 images;
+    // single-channel layers are replicated to RGB. Returns false if the
+    // file cannot be read.
+    static bool read(const std::string &filename, std::vector<std::string> &names,
+                     std::vector<Image> &images);
+};
+
+#endif // LAYER_FILE_H
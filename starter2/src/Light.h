@@ -35,6 +35,9 @@ class DirectionalLight : public Light
         Vector3f &intensity,
         float &distToLight) const override;
 
+    const Vector3f & getDirection() const { return _direction; }
+    const Vector3f & getColor() const { return _color; }
+
   private:
     Vector3f _direction;
     Vector3f _color;
@@ -54,6 +57,10 @@ class PointLight : public Light
         Vector3f &intensity,
         float &distToLight) const override;
 
+    const Vector3f & getPosition() const { return _position; }
+    const Vector3f & getColor() const { return _color; }
+    float getFalloff() const { return _falloff; }
+
   private:
     Vector3f _position;
     Vector3f _color;
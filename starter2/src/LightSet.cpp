@@ -0,0 +1,255 @@
+#include "LightSet.h"
+
+#include "Light.h"
+#include "RenderStats.h"
+#include "SceneParser.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+
+void
+LightSample::resize(int n)
+{
+    lx.resize(n); ly.resize(n); lz.resize(n);
+    ir.resize(n); ig.resize(n); ib.resize(n);
+    dist.resize(n);
+    cr.resize(n); cg.resize(n); cb.resize(n);
+    cosRV.resize(n);
+    visible.resize(n);
+    light.resize(n);
+    order.resize(n);
+}
+
+LightSet::LightSet(const SceneParser &scene)
+{
+    RenderStats::Timer timer(RenderStats::BUILD);
+    for (int i = 0; i < scene.getNumLights(); ++i) {
+        const Light *light = scene.getLight(i);
+        if (const DirectionalLight *d = dynamic_cast<const DirectionalLight *>(light)) {
+            const Vector3f tolight = -d->getDirection();
+            _dx.push_back(tolight[0]); _dy.push_back(tolight[1]); _dz.push_back(tolight[2]);
+            _dr.push_back(d->getColor()[0]); _dg.push_back(d->getColor()[1]); _db.push_back(d->getColor()[2]);
+            _dirLight.push_back(i);
+        } else if (const PointLight *p = dynamic_cast<const PointLight *>(light)) {
+            _px.push_back(p->getPosition()[0]); _py.push_back(p->getPosition()[1]); _pz.push_back(p->getPosition()[2]);
+            _pr.push_back(p->getColor()[0]); _pg.push_back(p->getColor()[1]); _pb.push_back(p->getColor()[2]);
+            _falloff.push_back(p->getFalloff());
+            _pointLight.push_back(i);
+        } else {
+            printf("Unsupported light type\n");
+            exit(1);
+        }
+    }
+
+    if (!_px.empty()) {
+        std::vector<int> lights(_px.size());
+        for (size_t i = 0; i < lights.size(); ++i) {
+            lights[i] = (int)i;
+        }
+        _nodes.reserve(2 * lights.size());
+        build(lights, 0, (int)lights.size());
+    }
+}
+
+// Builds the subtree over lights[begin, end), split at the median of the
+// longest axis of its bounds, and returns its node index.
+int
+LightSet::build(std::vector<int> &lights, int begin, int end)
+{
+    const int index = (int)_nodes.size();
+    _nodes.push_back(Node());
+
+    Node n;
+    for (int a = 0; a < 3; ++a) {
+        n.lo[a] = std::numeric_limits<float>::max();
+        n.hi[a] = -std::numeric_limits<float>::max();
+    }
+    n.maxColor = 0;
+    n.minFalloff = std::numeric_limits<float>::max();
+    n.power = 0;
+    for (int k = begin; k < end; ++k) {
+        const int i = lights[k];
+        const float pos[3] = { _px[i], _py[i], _pz[i] };
+        for (int a = 0; a < 3; ++a) {
+            n.lo[a] = std::min(n.lo[a], pos[a]);
+            n.hi[a] = std::max(n.hi[a], pos[a]);
+        }
+        const float color = std::max(_pr[i], std::max(_pg[i], _pb[i]));
+        n.maxColor = std::max(n.maxColor, color);
+        n.minFalloff = std::min(n.minFalloff, _falloff[i]);
+        n.power += color / _falloff[i];
+    }
+
+    if (end - begin == 1) {
+        n.left = n.right = -1;
+        n.light = lights[begin];
+    } else {
+        int axis = 0;
+        for (int a = 1; a < 3; ++a) {
+            if (n.hi[a] - n.lo[a] > n.hi[axis] - n.lo[axis]) {
+                axis = a;
+            }
+        }
+        const std::vector<float> &coord = axis == 0 ? _px : (axis == 1 ? _py : _pz);
+        const int mid = (begin + end) / 2;
+        std::nth_element(lights.begin() + begin, lights.begin() + mid, lights.begin() + end,
+            [&coord](int a, int b) { return coord[a] < coord[b]; });
+        n.light = -1;
+        n.left = build(lights, begin, mid);
+        n.right = build(lights, mid, end);
+    }
+
+    _nodes[index] = n;
+    return index;
+}
+
+float
+LightSet::boxDistance2(const Node &n, const Vector3f &p)
+{
+    float d2 = 0;
+    for (int a = 0; a < 3; ++a) {
+        float d = std::max(n.lo[a] - p[a], std::max(0.0f, p[a] - n.hi[a]));
+        d2 += d * d;
+    }
+    return d2;
+}
+
+float
+LightSet::importance(const Node &n, const Vector3f &p)
+{
+    // distance to the center of the box, but no less than its radius, so
+    // a box around p does not look infinitely bright
+    float d2 = 0;
+    float r2 = 0;
+    for (int a = 0; a < 3; ++a) {
+        float c = 0.5f * (n.lo[a] + n.hi[a]);
+        float h = 0.5f * (n.hi[a] - n.lo[a]);
+        d2 += (p[a] - c) * (p[a] - c);
+        r2 += h * h;
+    }
+    return n.power / std::max(std::max(d2, r2), 1e-8f);
+}
+
+void
+LightSet::setDirectionalLanes(LightSample &s) const
+{
+    for (size_t i = 0; i < _dx.size(); ++i) {
+        s.lx[i] = _dx[i]; s.ly[i] = _dy[i]; s.lz[i] = _dz[i];
+        s.ir[i] = _dr[i]; s.ig[i] = _dg[i]; s.ib[i] = _db[i];
+        s.dist[i] = std::numeric_limits<float>::max();
+        s.light[i] = _dirLight[i];
+    }
+}
+
+void
+LightSet::setPointLane(int i, int lane, const Vector3f &p, float scale, LightSample &s) const
+{
+    // the same operations, in the same order, as PointLight::getIllumination
+    float x = _px[i] - p[0];
+    float y = _py[i] - p[1];
+    float z = _pz[i] - p[2];
+    float d = std::sqrt(x * x + y * y + z * z);
+    s.lx[lane] = x / d; s.ly[lane] = y / d; s.lz[lane] = z / d;
+    s.dist[lane] = d;
+    float attenuation = _falloff[i] * d * d;
+    s.ir[lane] = _pr[i] / attenuation * scale;
+    s.ig[lane] = _pg[i] / attenuation * scale;
+    s.ib[lane] = _pb[i] / attenuation * scale;
+    s.light[lane] = _pointLight[i];
+}
+
+void
+LightSet::sortLanes(int numDir, LightSample &s)
+{
+    for (int l = 0; l < s.size(); ++l) {
+        s.order[l] = l;
+    }
+    std::inplace_merge(s.order.begin(), s.order.begin() + numDir, s.order.end(),
+        [&s](int a, int b) { return s.light[a] < s.light[b]; });
+}
+
+void
+LightSet::illuminate(const Vector3f &p, float cutoff, LightSample &s) const
+{
+    const int nd = (int)_dx.size();
+    const int np = (int)_px.size();
+
+    if (cutoff <= 0 || np == 0) {
+        s.resize(nd + np);
+        setDirectionalLanes(s);
+        for (int i = 0; i < np; ++i) {
+            setPointLane(i, nd + i, p, 1.0f, s);
+        }
+        sortLanes(nd, s);
+        return;
+    }
+
+    // point lights whose subtree can reach cutoff at p; a balanced tree
+    // over an int-indexed array is never deeper than 32 levels
+    static thread_local std::vector<int> survivors;
+    survivors.clear();
+    int stack[64];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        const Node &n = _nodes[stack[--top]];
+        if (n.maxColor < cutoff * n.minFalloff * boxDistance2(n, p)) {
+            continue;
+        }
+        if (n.left < 0) {
+            survivors.push_back(n.light);
+        } else {
+            stack[top++] = n.left;
+            stack[top++] = n.right;
+        }
+    }
+    // point light indices follow scene order
+    std::sort(survivors.begin(), survivors.end());
+
+    s.resize(nd + (int)survivors.size());
+    setDirectionalLanes(s);
+    for (size_t k = 0; k < survivors.size(); ++k) {
+        setPointLane(survivors[k], nd + (int)k, p, 1.0f, s);
+    }
+    sortLanes(nd, s);
+}
+
+void
+LightSet::illuminateOne(const Vector3f &p, float u, LightSample &s) const
+{
+    const int nd = (int)_dx.size();
+    if (_nodes.empty()) {
+        s.resize(nd);
+        setDirectionalLanes(s);
+        sortLanes(nd, s);
+        return;
+    }
+
+    float pdf = 1;
+    int node = 0;
+    while (_nodes[node].left >= 0) {
+        const Node &n = _nodes[node];
+        float wl = importance(_nodes[n.left], p);
+        float wr = importance(_nodes[n.right], p);
+        float pl = wl + wr > 0 ? wl / (wl + wr) : 0.5f;
+        // rescale u to [0, 1) so it can pick again at the next level
+        if (u < pl) {
+            u = u / pl;
+            pdf *= pl;
+            node = n.left;
+        } else {
+            u = (u - pl) / (1 - pl);
+            pdf *= 1 - pl;
+            node = n.right;
+        }
+        u = std::min(u, 0.99999994f);
+    }
+
+    s.resize(nd + 1);
+    setDirectionalLanes(s);
+    setPointLane(_nodes[node].light, nd, p, 1.0f / pdf, s);
+    sortLanes(nd, s);
+}
@@ -0,0 +1,112 @@
+#ifndef LIGHT_SET_H
+#define LIGHT_SET_H
+
+#include <Vector3f.h>
+
+#include <vector>
+
+class SceneParser;
+
+// Illumination of one point by a set of lights, one lane per light.
+// Directional lights come first, then point lights; order lists the lanes
+// by scene light index, which is the order contributions are summed in.
+struct LightSample
+{
+    // unit direction from the point to the light
+    std::vector<float> lx, ly, lz;
+    // light intensity arriving at the point
+    std::vector<float> ir, ig, ib;
+    // distance to the light (float max for directional lights)
+    std::vector<float> dist;
+    // shaded contribution, filled in by Material::shade
+    std::vector<float> cr, cg, cb;
+    // scratch for Material::shade
+    std::vector<float> cosRV;
+    // 1 if the light is unoccluded, filled in by Renderer::shadowMask
+    std::vector<unsigned char> visible;
+    // scene index of the light of each lane
+    std::vector<int> light;
+    // lanes sorted by scene index
+    std::vector<int> order;
+
+    int size() const { return (int)lx.size(); }
+    void resize(int n);
+
+    Vector3f getDirection(int i) const { return Vector3f(lx[i], ly[i], lz[i]); }
+    Vector3f getContribution(int i) const { return Vector3f(cr[i], cg[i], cb[i]); }
+
+    // true if the light adds nothing here, so it needs no shadow ray
+    bool isBlack(int i) const { return cr[i] == 0 && cg[i] == 0 && cb[i] == 0; }
+};
+
+// The lights of a scene in structure-of-arrays form, grouped by type, so
+// a point is lit by all of them in straight loops instead of one virtual
+// getIllumination call per light.
+//
+// Point lights are also kept in a bounding volume hierarchy. Each node
+// stores the bounds of the light positions below it, their brightest
+// color channel and their smallest falloff, so no light below can deliver
+// more than maxColor / (minFalloff * d^2) to a point at distance d from
+// the box.
+class LightSet
+{
+public:
+    explicit LightSet(const SceneParser &scene);
+
+    int size() const { return (int)(_dx.size() + _px.size()); }
+
+    // Fills s with every directional light and every point light whose
+    // intensity at p can reach cutoff in some channel; subtrees that
+    // cannot are skipped whole. With cutoff 0 every light is kept, with
+    // the same results as Light::getIllumination.
+    void illuminate(const Vector3f &p, float cutoff, LightSample &s) const;
+
+    // Fills s with every directional light and one point light, picked by
+    // walking down the hierarchy with u in [0, 1), choosing each child in
+    // proportion to a rough estimate of its intensity at p. The picked
+    // intensity is divided by its probability, so the sum over s is an
+    // unbiased estimate of the sum over all lights.
+    void illuminateOne(const Vector3f &p, float u, LightSample &s) const;
+
+private:
+    struct Node
+    {
+        float lo[3], hi[3];  // bounds of the light positions
+        float maxColor;      // brightest channel of any light below
+        float minFalloff;    // smallest falloff of any light below
+        float power;         // sum of brightest channel / falloff
+        int left, right;     // children, -1 for a leaf
+        int light;           // point light of a leaf
+    };
+
+    int build(std::vector<int> &lights, int begin, int end);
+
+    // squared distance from p to the bounds of n, 0 inside
+    static float boxDistance2(const Node &n, const Vector3f &p);
+
+    // rough intensity of the lights of n at p, for picking
+    static float importance(const Node &n, const Vector3f &p);
+
+    void setDirectionalLanes(LightSample &s) const;
+    void setPointLane(int i, int lane, const Vector3f &p, float scale, LightSample &s) const;
+
+    // fills s.order from s.light; the directional lanes [0, numDir) and
+    // the point lanes after them are each already in scene order
+    static void sortLanes(int numDir, LightSample &s);
+
+    // directional lights: direction to the light, color and scene index
+    std::vector<float> _dx, _dy, _dz;
+    std::vector<float> _dr, _dg, _db;
+    std::vector<int> _dirLight;
+
+    // point lights: position, color, falloff and scene index
+    std::vector<float> _px, _py, _pz;
+    std::vector<float> _pr, _pg, _pb;
+    std::vector<float> _falloff;
+    std::vector<int> _pointLight;
+
+    // point light hierarchy, root first
+    std::vector<Node> _nodes;
+};
+
+#endif // LIGHT_SET_H
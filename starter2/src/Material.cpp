@@ -1,4 +1,5 @@
 #include "Material.h"
+#include "LightSet.h"
 #include <math.h>
 
 float clamp(const Vector3f &L, const Vector3f &N)
@@ -30,3 +31,50 @@ Vector3f Material::shade(const Ray &ray,
 
     return diffuse + specular;
 }
+
+void Material::shade(const Ray &ray,
+                     const Hit &hit,
+                     LightSample &s) const
+{
+    const int n = (int)s.lx.size();
+    const Vector3f N = hit.getNormal().normalized();
+    const Vector3f V = -ray.getDirection().normalized();
+    const float *lx = s.lx.data(), *ly = s.ly.data(), *lz = s.lz.data();
+    const float *ir = s.ir.data(), *ig = s.ig.data(), *ib = s.ib.data();
+    float *cr = s.cr.data(), *cg = s.cg.data(), *cb = s.cb.data();
+    float *cosRV = s.cosRV.data();
+
+    // diffuse term, and the clamped cosine between the reflected light
+    // direction and the view direction
+    for (int i = 0; i < n; ++i)
+    {
+        float ln = lx[i] * N[0] + ly[i] * N[1] + lz[i] * N[2];
+        float c = ln <= 0 ? 0.0f : ln;
+        float rx = 2.0f * c * N[0] - lx[i];
+        float ry = 2.0f * c * N[1] - ly[i];
+        float rz = 2.0f * c * N[2] - lz[i];
+        float rlen = sqrtf(rx * rx + ry * ry + rz * rz);
+        float rv = (rx / rlen) * V[0] + (ry / rlen) * V[1] + (rz / rlen) * V[2];
+        cosRV[i] = rv <= 0 ? 0.0f : rv;
+        cr[i] = c * ir[i] * _diffuseColor[0];
+        cg[i] = c * ig[i] * _diffuseColor[1];
+        cb[i] = c * ib[i] * _diffuseColor[2];
+    }
+
+    // specular term; powf only runs for lanes where it can be non-zero
+    if (_specularColor == Vector3f::ZERO)
+    {
+        return;
+    }
+    for (int i = 0; i < n; ++i)
+    {
+        if (cosRV[i] == 0 && _shininess > 0)
+        {
+            continue;
+        }
+        float f = powf(cosRV[i], _shininess);
+        cr[i] += f * ir[i] * _specularColor[0];
+        cg[i] += f * ig[i] * _specularColor[1];
+        cb[i] += f * ib[i] * _specularColor[2];
+    }
+}
@@ -10,6 +10,8 @@
 
 #include <string>
 
+struct LightSample;
+
 class Material
 {
   public:
@@ -34,6 +36,13 @@ class Material
         const Vector3f &dirToLight,
         const Vector3f &lightIntensity);
 
+    // Shades hit for all lights of s at once, writing each light's
+    // diffuse + specular term to s.cr/cg/cb. Light directions in s are
+    // already unit length; the normal and view vector are normalized once.
+    void shade(const Ray &ray,
+        const Hit &hit,
+        LightSample &s) const;
+
 protected:
 
     Vector3f _diffuseColor;
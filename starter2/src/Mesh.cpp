@@ -113,10 +113,7 @@ bool
 Mesh::intersect(const Ray &r, float tmin, Hit &h) const
 {
 #if 1
-    ray = &r;
-    hit = &h;
-    tm = tmin;
-    return octree.intersect(r);
+    return octree.intersect(r, tmin, h);
 #else
     bool result = false;
     for (Triangle t : _triangles) {
@@ -129,9 +126,21 @@ Mesh::intersect(const Ray &r, float tmin, Hit &h) const
 }
 
 bool
-Mesh::intersectTrig(int idx, const Ray &r) const
+Mesh::intersectTrig(int idx, const Ray &r, float tmin, Hit &h) const
 {
     const Triangle &triangle = _triangles[idx];
-    bool result = triangle.intersect(r, tm, *hit);
+    bool result = triangle.intersect(r, tmin, h);
+    if (result) {
+        h.primitive = idx;
+    }
     return result;
 }
+
+bool
+Mesh::intersectPrimitive(int primitive, const Ray &r, float tmin, Hit &h) const
+{
+    if (primitive < 0) {
+        return intersect(r, tmin, h);
+    }
+    return intersectTrig(primitive, r, tmin, h);
+}
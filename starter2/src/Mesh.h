@@ -15,7 +15,10 @@ class Mesh : public Object3D {
 
     virtual bool intersect(const Ray &r, float tmin, Hit &h) const;
 
-    virtual bool intersectTrig(int idx, const Ray &r) const;
+    // Tests triangle idx only; a hit records idx in Hit::primitive.
+    virtual bool intersectTrig(int idx, const Ray &r, float tmin, Hit &h) const;
+
+    virtual bool intersectPrimitive(int primitive, const Ray &r, float tmin, Hit &h) const;
 
     const std::vector<Triangle> & getTriangles() const {
         return _triangles;
@@ -23,10 +26,7 @@ class Mesh : public Object3D {
 
   private:
     std::vector<Triangle> _triangles;
-    mutable Octree octree;
-    mutable const Ray *ray;
-    mutable Hit *hit;
-    mutable float tm;
+    Octree octree;
 };
 
 #endif
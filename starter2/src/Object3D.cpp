@@ -1,8 +1,12 @@
 #include "Object3D.h"
 #include "iostream"
+#include "RenderStats.h"
+#include "VecUtils.h"
 
 bool Sphere::intersect(const Ray &r, float tmin, Hit &h) const
 {
+    RenderStats::count(RenderStats::SPHERE_TESTS);
+
     // BEGIN STARTER
 
     // We provide sphere intersection code for you.
@@ -53,6 +57,7 @@ bool Sphere::intersect(const Ray &r, float tmin, Hit &h) const
         Vector3f normal = r.pointAtParameter(t) - _center;
         normal = normal.normalized();
         h.set(t, this->material, normal);
+        RenderStats::count(RenderStats::SPHERE_HITS);
         return true;
     }
     // END STARTER
@@ -76,10 +81,11 @@ bool Group::intersect(const Ray &r, float tmin, Hit &h) const
     // BEGIN STARTER
     // we implemented this for you
     bool hit = false;
-    for (Object3D *o : m_members)
+    for (size_t i = 0; i < m_members.size(); ++i)
     {
-        if (o->intersect(r, tmin, h))
+        if (m_members[i]->intersect(r, tmin, h))
         {
+            h.object = (int)i;
             hit = true;
         }
     }
@@ -87,6 +93,16 @@ bool Group::intersect(const Ray &r, float tmin, Hit &h) const
     // END STARTER
 }
 
+bool Group::intersectPrimitive(int i, int primitive, const Ray &r, float tmin, Hit &h) const
+{
+    if (m_members[i]->intersectPrimitive(primitive, r, tmin, h))
+    {
+        h.object = i;
+        return true;
+    }
+    return false;
+}
+
 Vector3f Plane::getPointOnPlane() const
 {
     if (std::abs(_normal.x()) > 1e-6)
@@ -112,6 +128,13 @@ Plane::Plane(const Vector3f &normal, float d, Material *m) : Object3D(m)
 }
 
 bool Plane::intersect(const Ray &r, float tmin, Hit &h) const
+{
+    bool hit = intersectPlane(r, tmin, h);
+    RenderStats::record(RenderStats::PLANE_TESTS, hit);
+    return hit;
+}
+
+bool Plane::intersectPlane(const Ray &r, float tmin, Hit &h) const
 {
     const Vector3f &rayOrigin = r.getOrigin();
     const Vector3f &rayDir = r.getDirection();
@@ -140,6 +163,7 @@ bool Plane::intersect(const Ray &r, float tmin, Hit &h) const
 
 bool Triangle::intersect(const Ray &r, float tmin, Hit &h) const
 {
+    RenderStats::count(RenderStats::TRIANGLE_TESTS);
 
     Vector3f u = _v[1] - _v[0];
     Vector3f v = _v[2] - _v[0];
@@ -150,7 +174,7 @@ bool Triangle::intersect(const Ray &r, float tmin, Hit &h) const
     my_hit.set(std::numeric_limits<float>::max(), this->material, Vector3f::ZERO);
     Plane plane(n, dis, this->material);
 
-    bool my_judge = plane.intersect(r, tmin, my_hit);
+    bool my_judge = plane.intersectPlane(r, tmin, my_hit);
     if (my_judge == false)
     {
         return false;
@@ -181,6 +205,7 @@ bool Triangle::intersect(const Ray &r, float tmin, Hit &h) const
     if (my_hit.getT() < h.getT())
     {
         h.set(my_hit.getT(), this->material, final_normal);
+        RenderStats::count(RenderStats::TRIANGLE_HITS);
         return true;
     }
 
@@ -191,40 +216,38 @@ Transform::Transform(const Matrix4f &m,
                      Object3D *obj) : _object(obj)
 {
     _m = m;
+    // scene transforms are affine, so this takes the cheap path
+    _inverse = m.inverse();
+    _normalMatrix = _inverse.transposed();
 }
 
-Matrix4f inverseTranspose(const Matrix4f &m)
+bool Transform::intersect(const Ray &r, float tmin, Hit &h) const
 {
-    Matrix4f inverseMat = m.inverse();
-    inverseMat.transpose();
-
-    return inverseMat;
+    return intersectPrimitive(-1, r, tmin, h);
 }
 
-bool Transform::intersect(const Ray &r, float tmin, Hit &h) const
+bool Transform::intersectPrimitive(int primitive, const Ray &r, float tmin, Hit &h) const
 {
-    Matrix4f inv_m = _m.inverse();
-    Vector4f ray_origin_local = inv_m * Vector4f(r.getOrigin(), 1.0f);
-    Vector4f ray_dir_local = inv_m * Vector4f(r.getDirection(), 0.0f);
-    Ray ray_local = Ray(Vector3f(ray_origin_local.x(), ray_origin_local.y(), ray_origin_local.z()),
-                        Vector3f(ray_dir_local.x(), ray_dir_local.y(), ray_dir_local.z()));
+    RenderStats::count(RenderStats::TRANSFORM_TESTS);
+
+    Ray ray_local = Ray(VecUtils::transformPoint(_inverse, r.getOrigin()),
+                        VecUtils::transformDirection(_inverse, r.getDirection()));
     Hit my_hit;
     my_hit.set(10000, this->material, Vector3f::ZERO);
-    if (_object->intersect(ray_local, tmin, my_hit) == false)
+    if (_object->intersectPrimitive(primitive, ray_local, tmin, my_hit) == false)
     {
         return false;
     }
 
-    Vector3f normal_local = my_hit.getNormal();
-    Matrix4f inv_transpose_m = inverseTranspose(_m);
-    Vector4f normal_world_4f = inv_transpose_m * Vector4f(normal_local, 0.0f);
-    Vector3f normal_world = Vector3f(normal_world_4f.x(), normal_world_4f.y(), normal_world_4f.z());
-    normal_world = normal_world.normalized();
+    Vector3f normal_world =
+        VecUtils::transformDirection(_normalMatrix, my_hit.getNormal()).normalized();
 
     if (my_hit.getT() < h.getT())
     {
         h.set(my_hit.getT(), _object->material, normal_world);
+        h.primitive = my_hit.primitive;
+        RenderStats::count(RenderStats::TRANSFORM_HITS);
         return true;
     }
     return false;
-}
\ No newline at end of file
+}
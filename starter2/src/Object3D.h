@@ -30,6 +30,14 @@ public:
 
     virtual bool intersect(const Ray &r, float tmin, Hit &h) const = 0;
 
+    // Same as intersect, but only against the primitive that an earlier
+    // hit on this object recorded in Hit::primitive. Objects that are a
+    // single primitive, and primitive -1, test the whole object.
+    virtual bool intersectPrimitive(int primitive, const Ray &r, float tmin, Hit &h) const
+    {
+        return intersect(r, tmin, h);
+    }
+
     std::string   type;
     Material*     material;
 };
@@ -66,6 +74,10 @@ public:
     // Return true if intersection found
     virtual bool intersect(const Ray &r, float tmin, Hit &h) const override;
 
+    // Same as intersect, but only against one primitive of object i
+    // (see Object3D::intersectPrimitive)
+    bool intersectPrimitive(int i, int primitive, const Ray &r, float tmin, Hit &h) const;
+
     // Add object to group
     void addObject(Object3D *obj);
 
@@ -86,6 +98,10 @@ public:
 
     virtual bool intersect(const Ray &r, float tmin, Hit &h) const override;
 
+    // Same as intersect, but not counted as a plane test in RenderStats,
+    // for shapes that test their own plane first
+    bool intersectPlane(const Ray &r, float tmin, Hit &h) const;
+
 private:
     // TOOD fill in members
     float _d; // distance from origin
@@ -145,9 +161,13 @@ public:
 
     virtual bool intersect(const Ray &r, float tmin, Hit &h) const override;
 
+    virtual bool intersectPrimitive(int primitive, const Ray &r, float tmin, Hit &h) const override;
+
 private:
     Object3D *_object; //un-transformed object  
     Matrix4f _m; // transformation matrix
+    Matrix4f _inverse; // world to object, computed once
+    Matrix4f _normalMatrix; // inverse transpose of _m, for normals
 };
 
 
@@ -2,6 +2,7 @@
 #include "Vector3f.h"
 #include "Mesh.h"
 #include "Octree.h"
+#include "RenderStats.h"
 
 #include <vector>
 
@@ -115,6 +116,7 @@ Octree::buildNode(OctNode *parent,
 void
 Octree::build(Mesh *m)
 {
+    RenderStats::Timer timer(RenderStats::BUILD);
     mesh = m;
 
     const auto &tri = mesh->getTriangles();
@@ -205,10 +207,14 @@ Octree::proc_subtree(float tx0,
                      float tx1, 
                      float ty1, 
                      float tz1, 
-                     OctNode *node,
-                     const Ray &ray)
+                     const OctNode *node,
+                     uint8_t aa,
+                     const Ray &ray,
+                     float tmin,
+                     Hit &h) const
 {
     bool intersected = false;
+    RenderStats::count(RenderStats::OCTREE_NODES);
 
     if (tx1 < 0 || ty1 < 0 || tz1 < 0) {
         return intersected;
@@ -217,7 +223,7 @@ Octree::proc_subtree(float tx0,
     if (node->isTerm()) {
         //loop over things
         for (size_t ii = 0; ii < node->obj.size(); ii++) {
-            bool result = mesh->intersectTrig(node->obj[ii],ray);
+            bool result = mesh->intersectTrig(node->obj[ii], ray, tmin, h);
             intersected = intersected || result;
         }
         return intersected;
@@ -230,42 +236,42 @@ Octree::proc_subtree(float tx0,
     do {
         switch (currNode) {
         case 0: {
-            bool result = proc_subtree(tx0, ty0, tz0, txm, tym, tzm, node->child[aa],ray);
+            bool result = proc_subtree(tx0, ty0, tz0, txm, tym, tzm, node->child[aa], aa, ray, tmin, h);
             intersected |= result;
             currNode = new_node(txm, 4, tym, 2, tzm, 1);
         } break;
         case 1: {
-            bool result = proc_subtree(tx0, ty0, tzm, txm, tym, tz1, node->child[1^aa],ray);
+            bool result = proc_subtree(tx0, ty0, tzm, txm, tym, tz1, node->child[1^aa], aa, ray, tmin, h);
             intersected |= result;
             currNode = new_node(txm, 5, tym, 3, tz1, 8);
         } break;
         case 2: {
-            bool result = proc_subtree(tx0, tym, tz0, txm, ty1, tzm, node->child[2^aa],ray);
+            bool result = proc_subtree(tx0, tym, tz0, txm, ty1, tzm, node->child[2^aa], aa, ray, tmin, h);
             intersected |= result;
             currNode = new_node(txm, 6, ty1, 8, tzm, 3);
         } break;
         case 3: {
-            bool result = proc_subtree(tx0, tym, tzm, txm, ty1, tz1, node->child[3^aa],ray);
+            bool result = proc_subtree(tx0, tym, tzm, txm, ty1, tz1, node->child[3^aa], aa, ray, tmin, h);
             intersected |= result;
             currNode = new_node(txm, 7, ty1, 8, tz1, 8);
         } break;
         case 4: {
-            bool result = proc_subtree(txm, ty0, tz0, tx1, tym, tzm, node->child[4^aa],ray);
+            bool result = proc_subtree(txm, ty0, tz0, tx1, tym, tzm, node->child[4^aa], aa, ray, tmin, h);
             intersected |= result;
             currNode = new_node(tx1, 8, tym, 6, tzm, 5);
         } break;
         case 5: {
-            bool result = proc_subtree(txm, ty0, tzm, tx1, tym, tz1, node->child[5^aa],ray);
+            bool result = proc_subtree(txm, ty0, tzm, tx1, tym, tz1, node->child[5^aa], aa, ray, tmin, h);
             intersected |= result;
             currNode = new_node(tx1, 8, tym, 7, tz1, 8);
         } break;
         case 6: {
-            bool result = proc_subtree(txm, tym, tz0, tx1, ty1, tzm, node->child[6^aa],ray);
+            bool result = proc_subtree(txm, tym, tz0, tx1, ty1, tzm, node->child[6^aa], aa, ray, tmin, h);
             intersected |= result;
             currNode = new_node(tx1, 8, ty1, 8, tzm, 7);
         } break;
         case 7: {
-            bool result = proc_subtree(txm, tym, tzm, tx1, ty1, tz1, node->child[7^aa],ray);
+            bool result = proc_subtree(txm, tym, tzm, tx1, ty1, tz1, node->child[7^aa], aa, ray, tmin, h);
             intersected |= result;
             currNode = 8;
         } break;
@@ -276,7 +282,7 @@ Octree::proc_subtree(float tx0,
 }
 
 bool
-Octree::intersect(const Ray &ray)
+Octree::intersect(const Ray &ray, float tmin, Hit &h) const
 {
     Vector3f rd = ray.getDirection();
 
@@ -284,7 +290,7 @@ Octree::intersect(const Ray &ray)
     rd.normalize();
     Vector3f ro = ray.getOrigin();
 
-    aa = 0;
+    uint8_t aa = 0;
     Vector3f size = box.mx + box.mn;
     if (rd[0]<0.0f) {
         ro[0] = size[0] - ro[0];
@@ -320,7 +326,7 @@ Octree::intersect(const Ray &ray)
     float tz1 = (box.mx[2] - ro[2]) * divz;
 
     if (std::max(std::max(tx0,ty0), tz0) <= std::min(std::min(tx1, ty1), tz1)) {
-        return proc_subtree(tx0, ty0, tz0, tx1, ty1, tz1, &root, ray);
+        return proc_subtree(tx0, ty0, tz0, tx1, ty1, tz1, &root, aa, ray, tmin, h);
     } else {
         return false;
     }
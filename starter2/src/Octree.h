@@ -37,7 +37,7 @@ struct OctNode
     }
 
     ///@brief is this terminal
-    bool isTerm() {
+    bool isTerm() const {
         return child[0] == nullptr;
     }
 
@@ -54,7 +54,9 @@ class Octree
 
     void build(Mesh *m);
 
-    bool intersect(const Ray &ray);
+    // Closest hit along ray beyond tmin; updates h like Object3D::intersect.
+    // Traversal state lives on the stack, so concurrent calls are safe.
+    bool intersect(const Ray &ray, float tmin, Hit &h) const;
 
   private:
     void buildNode(OctNode *parent, 
@@ -65,17 +67,17 @@ class Octree
 
     bool proc_subtree(float tx0, float ty0, float tz0, 
                       float tx1, float ty1, float tz1, 
-                      OctNode *node, const Ray &r);
+                      const OctNode *node, uint8_t aa,
+                      const Ray &r, float tmin, Hit &h) const;
 
     // if a node contains more than 7 triangles and it 
     // hasn't reached the max level yet, split
     static const int max_trig = 7;
 
     int maxLevel;
-    Mesh *mesh;
+    const Mesh *mesh;
     Box box;
     OctNode root;
-    uint8_t aa;
 };
 
 #endif
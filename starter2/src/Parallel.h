@@ -0,0 +1,59 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+// Number of worker threads used by parallelFor. Falls back to a single
+// thread when the hardware concurrency cannot be determined.
+inline int
+defaultThreadCount()
+{
+    unsigned int n = std::thread::hardware_concurrency();
+    return n > 0 ? (int)n : 1;
+}
+
+// Calls body(i) for every i in [begin, end), spread over worker threads.
+// Indices are handed out one at a time from a shared counter, so rows of
+// uneven cost still balance. body must be safe to run concurrently for
+// distinct indices.
+template<typename F>
+void
+parallelFor(int begin, int end, const F &body, int threads = 0)
+{
+    if (end <= begin) {
+        return;
+    }
+    if (threads <= 0) {
+        threads = defaultThreadCount();
+    }
+    threads = std::min(threads, end - begin);
+
+    if (threads == 1) {
+        for (int i = begin; i < end; ++i) {
+            body(i);
+        }
+        return;
+    }
+
+    std::atomic<int> next(begin);
+    auto worker = [&]() {
+        for (int i = next++; i < end; i = next++) {
+            body(i);
+        }
+    };
+
+    std::vector<std::thread> pool;
+    pool.reserve(threads - 1);
+    for (int t = 1; t < threads; ++t) {
+        pool.emplace_back(worker);
+    }
+    worker();
+    for (std::thread &t : pool) {
+        t.join();
+    }
+}
+
+#endif // PARALLEL_H
@@ -0,0 +1,506 @@
+#include "Renderer.h"
+
+#include "Camera.h"
+#include "Filter.h"
+#include "Parallel.h"
+#include "PixelOrder.h"
+#include "RenderStats.h"
+#include "Sampler.h"
+#include "VecUtils.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+
+#define eps 1e-4f
+
+/**
+ * Completes the unit vector n to an orthonormal basis (t, s, n)
+ * (Duff et al. 2017).
+ */
+static void orthonormalBasis(const Vector3f &n, Vector3f &t, Vector3f &s)
+{
+    float sign = n[2] >= 0 ? 1.0f : -1.0f;
+    float a = -1.0f / (sign + n[2]);
+    float b = n[0] * n[1] * a;
+    t = Vector3f(1.0f + sign * n[0] * n[0] * a, sign * b, -sign * n[0]);
+    s = Vector3f(b, sign + n[1] * n[1] * a, -n[1]);
+}
+
+/**
+ * Cosine-weighted direction on the hemisphere around the unit normal n.
+ */
+static Vector3f cosineHemisphere(const Vector3f &n, float u1, float u2)
+{
+    float r = std::sqrt(u1);
+    float phi = 2.0f * (float)M_PI * u2;
+    float x = r * std::cos(phi);
+    float y = r * std::sin(phi);
+    float z = std::sqrt(std::max(0.0f, 1.0f - u1));
+
+    Vector3f t, s;
+    orthonormalBasis(n, t, s);
+    return (x * t + y * s + z * n).normalized();
+}
+
+static float luminance(const Vector3f &c)
+{
+    return 0.2126f * c[0] + 0.7152f * c[1] + 0.0722f * c[2];
+}
+
+/**
+ * Path tracing mode. Every pixel gets _args.samples paths, each driven by
+ * its own PixelSampler, so the image does not depend on the thread count.
+ * Tiles are handed out to threads, and each tile is owned by one thread
+ * for a whole pass, so samples are accumulated straight into fb without
+ * locks. With _args.progressive, each pass adds one sample per pixel and
+ * the running average is written to the output file after every pass.
+ * With _args.irradiance_cache, the cache is built first and then only
+ * read while sampling.
+ */
+void Renderer::pathTraceSampling(int w, int h, FrameBuffer& fb)
+{
+    Camera* cam = _scene.getCamera();
+    const float tmin = cam->getTMin();
+    const int spp = _args.samples;
+    const int passSize = _args.progressive ? 1 : spp;
+    const float sampleWeight = 1.0f / spp;
+
+    const int tile = _args.tile_size;
+    const int tilesX = (w + tile - 1) / tile;
+    const int tilesY = (h + tile - 1) / tile;
+    std::vector<int> tiles;
+    PixelOrder::generate(_pixelOrder, tilesX, tilesY, tiles);
+
+    const IrradianceCache* cache = nullptr;
+    if (_args.irradiance_cache && _args.bounces > 0){
+        buildIrradianceCache(w, h, tiles, tilesX);
+        cache = &_irradianceCache;
+    }
+
+    for (int first = 0; first < spp; first += passSize){
+        const int last = std::min(first + passSize, spp);
+
+        parallelFor(0, tilesX * tilesY, [&](int i) {
+            const int x0 = (tiles[i] % tilesX) * tile;
+            const int y0 = (tiles[i] / tilesX) * tile;
+            const int x1 = std::min(x0 + tile, w);
+            const int y1 = std::min(y0 + tile, h);
+            AOVSample sample;
+            for (int y = y0; y < y1; ++y){
+                for (int x = x0; x < x1; ++x){
+                    for (int s = first; s < last; ++s){
+                        PixelSampler sampler((uint32_t)(y * w + x), (uint32_t)s);
+                        float ndcx = 2 * ((x + sampler.next()) / w) - 1.0f;
+                        float ndcy = 2 * ((y + sampler.next()) / h) - 1.0f;
+                        Ray r = cam->generateRay(Vector2f(ndcx, ndcy));
+
+                        Hit hit;
+                        int hitCount = 0;
+                        sample.value[AOV_COLOR] = tracePath(r, tmin, _args.bounces, _pixelSpread, sampler,
+                            cache, hit, hitCount);
+                        RenderStats::record(RenderStats::PRIMARY_RAYS, hitCount > 0);
+                        primaryAOVs(hit, sample);
+                        if (_aovs & aovBit(AOV_HIT_COUNT)){
+                            sample.value[AOV_HIT_COUNT] = Vector3f(hitCount / (_args.bounces + 1.0f));
+                        }
+                        fb.addSample(x, y, sample, sampleWeight);
+                    }
+                }
+            }
+        }, _args.threads);
+
+        if (_args.progressive && fb.has(AOV_COLOR) && _aovFiles[AOV_COLOR].size()){
+            // a supersampled image is resolved like the final one
+            Image preview = _args.filter ?
+                reconstructionFilter().apply(fb.getImage(AOV_COLOR), _args.width, _args.height) :
+                fb.getImage(AOV_COLOR);
+            const float scale = (float)spp / last;
+            for (int c = 0; c < 3; ++c){
+                for (int y = 0; y < preview.getHeight(); ++y){
+                    float* row = preview.getRow(c, y);
+                    for (int x = 0; x < preview.getWidth(); ++x){
+                        row[x] *= scale;
+                    }
+                }
+            }
+            // encoded while the next pass renders
+            _writer.save(preview, _aovFiles[AOV_COLOR]);
+            std::cout << "pass " << last << "/" << spp << "\n";
+        }
+    }
+}
+
+/**
+ * Next-event estimation at a path vertex: the Phong contribution of the
+ * scene lights, each tested with a shadow ray. Light colors keep the
+ * Whitted convention, so the diffuse term matches directLighting.
+ */
+Vector3f
+Renderer::sampleLights(const Ray &r, const Hit &h, float tmin,
+                       PixelSampler &sampler) const
+{
+    static thread_local LightSample lights;
+
+    Vector3f hitPoint = r.pointAtParameter(h.getT());
+    if (_args.light_pick){
+        _lights.illuminateOne(hitPoint, sampler.next(), lights);
+    }
+    else{
+        _lights.illuminate(hitPoint, _args.light_cutoff, lights);
+    }
+    h.getMaterial()->shade(r, h, lights);
+    shadowMask(hitPoint, tmin, lights);
+
+    Vector3f color = Vector3f::ZERO;
+    for (int l : lights.order){
+        if (lights.visible[l]){
+            color += lights.getContribution(l);
+        }
+    }
+    return color;
+}
+
+/**
+ * One path through the scene. At each vertex the scene lights are sampled
+ * directly, then the path continues into either the diffuse lobe (cosine
+ * sampled, Lambertian with albedo = diffuse color) or the mirror lobe
+ * (weighted by the specular color), chosen by their luminance. Paths that
+ * leave the scene pick up the environment: the cube map, or the
+ * background color. Point and directional lights cannot be hit by
+ * chance, so nothing is counted twice. After 3 bounces, paths go through
+ * Russian roulette on their throughput. h receives the primary hit.
+ *
+ * spread is the cone angle of the ray, used to filter the environment.
+ * It is kept through mirror bounces. A diffuse bounce widens it to about
+ * the share of the hemisphere one of the pixel's samples stands for.
+ *
+ * With a cache, the diffuse indirect light at the primary hit is
+ * interpolated from it where it has valid records, and only the mirror
+ * lobe is traced from there.
+ */
+Vector3f
+Renderer::tracePath(const Ray &r, float tmin, int bounces, float spread, PixelSampler &sampler,
+                    const IrradianceCache *cache, Hit &h, int &hitCount) const
+{
+    const float diffuseSpread = std::sqrt(2 * (float)M_PI / _args.samples);
+    Vector3f color = Vector3f::ZERO;
+    Vector3f throughput(1.0f);
+    Ray ray = r;
+    Hit bounceHit;
+    Hit* hit = &h;
+
+    for (int depth = 0; ; ++depth)
+    {
+        bool found = _scene.getGroup()->intersect(ray, tmin, *hit);
+        // the first ray is counted by the caller, which knows its kind
+        if (depth > 0){
+            RenderStats::record(RenderStats::REFLECTION_RAYS, found);
+        }
+        if (!found){
+            color += throughput * _scene.getBackgroundColor(ray.getDirection(), spread);
+            break;
+        }
+        ++hitCount;
+
+        const Material* material = hit->getMaterial();
+        color += throughput * sampleLights(ray, *hit, tmin, sampler);
+
+        if (depth >= bounces){
+            break;
+        }
+
+        const Vector3f& kd = material->getDiffuseColor();
+        const Vector3f& ks = material->getSpecularColor();
+        Vector3f hitPoint = ray.pointAtParameter(hit->getT());
+        // normal on the side the ray came from
+        Vector3f n = hit->getNormal().normalized();
+        if (Vector3f::dot(n, ray.getDirection()) > 0){
+            n = -n;
+        }
+
+        // pick a lobe in proportion to its albedo
+        float pd = luminance(kd);
+        float ps = luminance(ks);
+        Vector3f irradiance;
+        if (cache && depth == 0 && pd > 0){
+            bool cached = cache->lookup(hitPoint, n, cache->getMaxError(), irradiance);
+            RenderStats::record(RenderStats::IRRADIANCE_LOOKUPS, cached);
+            if (cached){
+                color += throughput * kd * irradiance;
+                pd = 0;
+            }
+        }
+        if (pd + ps <= 0){
+            break;
+        }
+        pd = pd / (pd + ps);
+
+        Vector3f dir;
+        float u = sampler.next();
+        float u1 = sampler.next();
+        float u2 = sampler.next();
+        if (u < pd){
+            dir = cosineHemisphere(n, u1, u2);
+            spread = std::max(spread, diffuseSpread);
+            throughput = throughput * kd / pd;
+        }
+        else{
+            Ray reflected = reflectRay(ray, *hit);
+            dir = reflected.getDirection();
+            throughput = throughput * ks / (1 - pd);
+        }
+
+        if (depth >= 3){
+            float survive = std::min(1.0f,
+                std::max(throughput[0], std::max(throughput[1], throughput[2])));
+            if (sampler.next() >= survive){
+                break;
+            }
+            throughput = throughput / survive;
+        }
+
+        ray = Ray(hitPoint + eps * dir, dir);
+        bounceHit = Hit();
+        hit = &bounceHit;
+    }
+
+    return color;
+}
+
+/**
+ * Computes an irradiance record at p, with unit normal n facing the
+ * viewer, from a stratified cosine-weighted set of paths over the
+ * hemisphere. The rotational and translational gradients follow Ward and
+ * Heckbert 1992. footprint is the size of a pixel at p; the record radius
+ * is clamped so that its region of validity spans a few pixels, and so
+ * that extrapolating with the gradient stays within the irradiance.
+ */
+void
+Renderer::irradianceRecord(const Vector3f &p, const Vector3f &n, float tmin,
+                           float footprint, PixelSampler &sampler,
+                           IrradianceRecord &record) const
+{
+    const float pi = (float)M_PI;
+    const int M = std::max(2, (int)std::lround(std::sqrt(_args.ic_samples / pi)));
+    const int N = std::max(3, (int)std::lround(_args.ic_samples / (float)M));
+
+    Vector3f t, s;
+    orthonormalBasis(n, t, s);
+    // each stratum stands for this cone of the hemisphere
+    const float spread = std::sqrt(2 * pi / (M * N));
+
+    // radiance and hit distance of each stratum, [j * N + k]
+    std::vector<Vector3f> L(M * N);
+    std::vector<float> dist(M * N);
+    std::vector<float> tanTheta(M);
+    float invDist = 0;
+    for (int j = 0; j < M; ++j){
+        for (int k = 0; k < N; ++k){
+            float u1 = (j + sampler.next()) / M;
+            float u2 = (k + sampler.next()) / N;
+            float sinTheta = std::sqrt(u1);
+            float cosTheta = std::sqrt(std::max(0.0f, 1.0f - u1));
+            float phi = 2 * pi * u2;
+            Vector3f dir = (sinTheta * std::cos(phi) * t + sinTheta * std::sin(phi) * s +
+                cosTheta * n).normalized();
+
+            Hit hit;
+            int hitCount = 0;
+            L[j * N + k] = tracePath(Ray(p + eps * dir, dir), tmin, _args.bounces - 1,
+                spread, sampler, nullptr, hit, hitCount);
+            RenderStats::record(RenderStats::REFLECTION_RAYS, hitCount > 0);
+            dist[j * N + k] = hit.getMaterial() ? hit.getT() : std::numeric_limits<float>::max();
+            invDist += 1.0f / dist[j * N + k];
+        }
+        // at the center of the stratum
+        float u = (j + 0.5f) / M;
+        tanTheta[j] = std::sqrt(u / (1 - u));
+    }
+
+    record.position = p;
+    record.normal = n;
+    record.irradiance = Vector3f::ZERO;
+    for (int c = 0; c < 3; ++c){
+        record.rotGradient[c] = Vector3f::ZERO;
+        record.transGradient[c] = Vector3f::ZERO;
+    }
+    for (int i = 0; i < M * N; ++i){
+        record.irradiance += L[i];
+    }
+    record.irradiance = record.irradiance / (float)(M * N);
+
+    for (int k = 0; k < N; ++k){
+        // u: center direction of the column, v: perpendicular to it
+        float phi = 2 * pi * (k + 0.5f) / N;
+        Vector3f u = std::cos(phi) * t + std::sin(phi) * s;
+        Vector3f v = -std::sin(phi) * t + std::cos(phi) * s;
+        // perpendicular to the boundary with column k - 1
+        float phiMinus = 2 * pi * k / N;
+        Vector3f vMinus = -std::sin(phiMinus) * t + std::cos(phiMinus) * s;
+        const int km = (k + N - 1) % N;
+
+        for (int j = 0; j < M; ++j){
+            const Vector3f& Ljk = L[j * N + k];
+            for (int c = 0; c < 3; ++c){
+                record.rotGradient[c] += (tanTheta[j] * Ljk[c]) * v;
+            }
+
+            // boundary with ring j - 1
+            if (j > 0){
+                float sin2 = (float)j / M;
+                float r = std::min(dist[j * N + k], dist[(j - 1) * N + k]);
+                float f = (2 * pi / N) * std::sqrt(sin2) * (1 - sin2) / r;
+                const Vector3f& Lprev = L[(j - 1) * N + k];
+                for (int c = 0; c < 3; ++c){
+                    record.transGradient[c] += (f * (Ljk[c] - Lprev[c])) * u;
+                }
+            }
+            // boundary with column k - 1
+            float r = std::min(dist[j * N + k], dist[j * N + km]);
+            float f = (std::sqrt((j + 1.0f) / M) - std::sqrt((float)j / M)) / r;
+            const Vector3f& Lprev = L[j * N + km];
+            for (int c = 0; c < 3; ++c){
+                record.transGradient[c] += (f * (Ljk[c] - Lprev[c])) * vMinus;
+            }
+        }
+    }
+    for (int c = 0; c < 3; ++c){
+        record.rotGradient[c] = record.rotGradient[c] / (float)(M * N);
+        record.transGradient[c] = record.transGradient[c] / pi;
+    }
+
+    // harmonic mean distance, limited by the gradient and the footprint
+    float radius = invDist > 0 ? (M * N) / invDist : std::numeric_limits<float>::max();
+    for (int c = 0; c < 3; ++c){
+        float g = record.transGradient[c].abs();
+        if (g > 0){
+            radius = std::min(radius, record.irradiance[c] / g);
+        }
+    }
+    const float a = _args.ic_error;
+    record.radius = std::min(std::max(radius, 2 * footprint / a), 32 * footprint / a);
+}
+
+/**
+ * First pass of irradiance caching. Camera rays through pixel centers
+ * are traced on grids of decreasing spacing. Each primary diffuse hit
+ * that no record covers within _args.ic_error gets a new record.
+ *
+ * Within a grid, tiles run in parallel against the records of the
+ * previous grids, which are frozen, plus the tile's own new records.
+ * Those are merged into the cache, in tile order, between grids. So the
+ * cache is the same however many threads build it.
+ */
+void Renderer::buildIrradianceCache(int w, int h, const std::vector<int>& tiles, int tilesX)
+{
+    Camera* cam = _scene.getCamera();
+    const float tmin = cam->getTMin();
+    const int tile = _args.tile_size;
+    const int numTiles = (int)tiles.size();
+    const float footprint = pixelAngle(w);
+
+
+    struct PrimaryHit
+    {
+        bool valid;
+        Vector3f p, n;
+        float footprint;
+    };
+    auto primaryHit = [&](int x, int y) {
+        PrimaryHit ph;
+        Ray r = cam->generateRay(Vector2f(2 * ((x + 0.5f) / w) - 1.0f,
+                                          2 * ((y + 0.5f) / h) - 1.0f));
+        Hit hit;
+        bool found = _scene.getGroup()->intersect(r, tmin, hit);
+        RenderStats::record(RenderStats::PRIMARY_RAYS, found);
+        ph.valid = found && luminance(hit.getMaterial()->getDiffuseColor()) > 0;
+        if (ph.valid){
+            ph.p = r.pointAtParameter(hit.getT());
+            ph.n = hit.getNormal().normalized();
+            if (Vector3f::dot(ph.n, r.getDirection()) > 0){
+                ph.n = -ph.n;
+            }
+            ph.footprint = hit.getT() * footprint;
+        }
+        return ph;
+    };
+    auto tileBounds = [&](int i, int& x0, int& y0, int& x1, int& y1) {
+        x0 = (tiles[i] % tilesX) * tile;
+        y0 = (tiles[i] / tilesX) * tile;
+        x1 = std::min(x0 + tile, w);
+        y1 = std::min(y0 + tile, h);
+    };
+
+    // bounds of every point that can be looked up
+    std::vector<Vector3f> lo(numTiles, Vector3f(std::numeric_limits<float>::max()));
+    std::vector<Vector3f> hi(numTiles, Vector3f(-std::numeric_limits<float>::max()));
+    parallelFor(0, numTiles, [&](int i) {
+        int x0, y0, x1, y1;
+        tileBounds(i, x0, y0, x1, y1);
+        for (int y = y0; y < y1; ++y){
+            for (int x = x0; x < x1; ++x){
+                PrimaryHit ph = primaryHit(x, y);
+                if (ph.valid){
+                    lo[i] = VecUtils::min(lo[i], ph.p);
+                    hi[i] = VecUtils::max(hi[i], ph.p);
+                }
+            }
+        }
+    }, _args.threads);
+    Vector3f sceneLo = lo[0], sceneHi = hi[0];
+    for (int i = 1; i < numTiles; ++i){
+        sceneLo = VecUtils::min(sceneLo, lo[i]);
+        sceneHi = VecUtils::max(sceneHi, hi[i]);
+    }
+    if (sceneLo[0] > sceneHi[0]){
+        // nothing diffuse in view
+        _irradianceCache.reset(Vector3f(-1), Vector3f(1));
+        return;
+    }
+    _irradianceCache.reset(sceneLo, sceneHi);
+
+    std::vector<std::vector<IrradianceRecord> > fresh(numTiles);
+    for (int spacing = 8; spacing >= 1; spacing /= 2){
+        parallelFor(0, numTiles, [&](int i) {
+            int x0, y0, x1, y1;
+            tileBounds(i, x0, y0, x1, y1);
+            std::vector<IrradianceRecord>& local = fresh[i];
+            local.clear();
+            for (int y = y0; y < y1; ++y){
+                for (int x = x0; x < x1; ++x){
+                    // points of the previous, coarser grid are covered already
+                    if (x % spacing || y % spacing ||
+                        (spacing < 8 && x % (2 * spacing) == 0 && y % (2 * spacing) == 0)){
+                        continue;
+                    }
+                    PrimaryHit ph = primaryHit(x, y);
+                    if (!ph.valid){
+                        continue;
+                    }
+                    Vector3f sum = Vector3f::ZERO;
+                    float weightSum = 0;
+                    _irradianceCache.gather(ph.p, ph.n, _args.ic_error, sum, weightSum);
+                    for (const IrradianceRecord& r : local){
+                        IrradianceCache::gather(r, ph.p, ph.n, _args.ic_error, sum, weightSum);
+                    }
+                    if (weightSum > 0){
+                        continue;
+                    }
+                    // a sample index no camera sample uses
+                    PixelSampler sampler((uint32_t)(y * w + x), 0x80000000u);
+                    local.push_back(IrradianceRecord());
+                    irradianceRecord(ph.p, ph.n, tmin, ph.footprint, sampler, local.back());
+                }
+            }
+        }, _args.threads);
+
+        for (int i = 0; i < numTiles; ++i){
+            for (const IrradianceRecord& r : fresh[i]){
+                _irradianceCache.insert(r);
+            }
+        }
+    }
+    RenderStats::count(RenderStats::IRRADIANCE_RECORDS, _irradianceCache.size());
+}
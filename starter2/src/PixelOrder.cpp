@@ -0,0 +1,89 @@
+#include "PixelOrder.h"
+
+#include <cstdint>
+
+// Inverse of the Morton interleave for one axis: gathers every other bit.
+static
+uint32_t
+compactBits(uint32_t v)
+{
+    v &= 0x55555555;
+    v = (v | (v >> 1)) & 0x33333333;
+    v = (v | (v >> 2)) & 0x0f0f0f0f;
+    v = (v | (v >> 4)) & 0x00ff00ff;
+    v = (v | (v >> 8)) & 0x0000ffff;
+    return v;
+}
+
+// Position of the d-th cell along a Hilbert curve covering an n x n grid
+// (n a power of two).
+static
+void
+hilbertCell(int n, int d, int &x, int &y)
+{
+    x = 0;
+    y = 0;
+    for (int s = 1; s < n; s *= 2) {
+        int rx = 1 & (d / 2);
+        int ry = 1 & (d ^ rx);
+        if (ry == 0) {
+            if (rx == 1) {
+                x = s - 1 - x;
+                y = s - 1 - y;
+            }
+            int t = x;
+            x = y;
+            y = t;
+        }
+        x += s * rx;
+        y += s * ry;
+        d /= 4;
+    }
+}
+
+bool
+PixelOrder::parseType(const std::string &name, Type &type)
+{
+    if (name == "scanline") {
+        type = SCANLINE;
+    } else if (name == "morton") {
+        type = MORTON;
+    } else if (name == "hilbert") {
+        type = HILBERT;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+void
+PixelOrder::generate(Type type, int w, int h, std::vector<int> &order)
+{
+    order.clear();
+    order.reserve(w * h);
+
+    if (type == SCANLINE) {
+        for (int i = 0; i < w * h; ++i) {
+            order.push_back(i);
+        }
+        return;
+    }
+
+    int n = 1;
+    while (n < w || n < h) {
+        n *= 2;
+    }
+
+    for (int d = 0; d < n * n; ++d) {
+        int x, y;
+        if (type == MORTON) {
+            x = (int)compactBits((uint32_t)d);
+            y = (int)compactBits((uint32_t)d >> 1);
+        } else {
+            hilbertCell(n, d, x, y);
+        }
+        if (x < w && y < h) {
+            order.push_back(y * w + x);
+        }
+    }
+}
@@ -0,0 +1,29 @@
+#ifndef PIXEL_ORDER_H
+#define PIXEL_ORDER_H
+
+#include <string>
+#include <vector>
+
+// Order in which pixels inside a tile, and tiles inside an image, are
+// visited. Space-filling curves keep consecutive samples close in screen
+// space, so they touch the same parts of the scene and textures.
+class PixelOrder
+{
+public:
+    enum Type {
+        SCANLINE,
+        MORTON,
+        HILBERT,
+    };
+
+    // Look up an order by name (scanline, morton, hilbert).
+    // Returns false if the name is unknown.
+    static bool parseType(const std::string &name, Type &type);
+
+    // Fills order with the indices y * w + x of every cell of a w x h grid,
+    // in visiting order. Curves are generated on the enclosing power-of-two
+    // square and clipped to the grid.
+    static void generate(Type type, int w, int h, std::vector<int> &order);
+};
+
+#endif // PIXEL_ORDER_H
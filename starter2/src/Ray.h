@@ -51,14 +51,18 @@ public:
     // Constructors
     Hit() :
         material(NULL),
-        t(std::numeric_limits<float>::max())
+        t(std::numeric_limits<float>::max()),
+        object(-1),
+        primitive(-1)
     {
     }
 
     Hit(float argt, Material *argmaterial, const Vector3f &argnormal) :
         t(argt),
         material(argmaterial),
-        normal(argnormal)
+        normal(argnormal),
+        object(-1),
+        primitive(-1)
     {
     }
 
@@ -82,11 +86,14 @@ public:
         this->t = t;
         this->material = material;
         this->normal = normal;
+        this->primitive = -1;
     }
 
     float     t;
     Material* material;
     Vector3f  normal;
+    int       object; // index of the hit object in the top-level group
+    int       primitive; // index of the hit triangle in its mesh, or -1
 };
 
 inline std::ostream &
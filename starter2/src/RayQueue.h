@@ -0,0 +1,101 @@
+#ifndef RAY_QUEUE_H
+#define RAY_QUEUE_H
+
+#include "Ray.h"
+#include "Vector3f.h"
+
+#include <limits>
+#include <vector>
+
+class Material;
+
+// Structure-of-arrays queue of rays used by the wavefront renderer. Each
+// ray carries the pixel it contributes to and the index of its sample in
+// that pixel, an RGB weight (path throughput, or the unoccluded
+// contribution for shadow rays), a maximum distance and, for shadow rays,
+// the scene light it is cast toward (-1 for other rays).
+struct RayQueue
+{
+    std::vector<float> ox, oy, oz;
+    std::vector<float> dx, dy, dz;
+    std::vector<float> wr, wg, wb;
+    std::vector<float> tmax;
+    std::vector<int> pixel;
+    std::vector<int> sample;
+    std::vector<int> light;
+
+    int size() const {
+        return (int)pixel.size();
+    }
+
+    bool empty() const {
+        return pixel.empty();
+    }
+
+    void clear() {
+        ox.clear(); oy.clear(); oz.clear();
+        dx.clear(); dy.clear(); dz.clear();
+        wr.clear(); wg.clear(); wb.clear();
+        tmax.clear();
+        pixel.clear();
+        sample.clear();
+        light.clear();
+    }
+
+    void push(const Vector3f &origin,
+              const Vector3f &direction,
+              const Vector3f &weight,
+              int pix,
+              int s,
+              float maxT = std::numeric_limits<float>::max(),
+              int l = -1)
+    {
+        ox.push_back(origin[0]); oy.push_back(origin[1]); oz.push_back(origin[2]);
+        dx.push_back(direction[0]); dy.push_back(direction[1]); dz.push_back(direction[2]);
+        wr.push_back(weight[0]); wg.push_back(weight[1]); wb.push_back(weight[2]);
+        tmax.push_back(maxT);
+        pixel.push_back(pix);
+        sample.push_back(s);
+        light.push_back(l);
+    }
+
+    Ray getRay(int i) const {
+        return Ray(Vector3f(ox[i], oy[i], oz[i]), Vector3f(dx[i], dy[i], dz[i]));
+    }
+
+    Vector3f getWeight(int i) const {
+        return Vector3f(wr[i], wg[i], wb[i]);
+    }
+};
+
+// Closest hits for the rays of a RayQueue, in the same order. A null
+// material marks a miss.
+struct HitQueue
+{
+    std::vector<float> t;
+    std::vector<float> nx, ny, nz;
+    std::vector<Material*> material;
+    std::vector<int> object;
+
+    void resize(int n) {
+        t.resize(n);
+        nx.resize(n); ny.resize(n); nz.resize(n);
+        material.resize(n);
+        object.resize(n);
+    }
+
+    void set(int i, const Hit &h) {
+        t[i] = h.t;
+        nx[i] = h.normal[0]; ny[i] = h.normal[1]; nz[i] = h.normal[2];
+        material[i] = h.material;
+        object[i] = h.object;
+    }
+
+    Hit getHit(int i) const {
+        Hit h(t[i], material[i], Vector3f(nx[i], ny[i], nz[i]));
+        h.object = object[i];
+        return h;
+    }
+};
+
+#endif // RAY_QUEUE_H
@@ -0,0 +1,76 @@
+#include "RaySort.h"
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+template<typename T>
+static
+void
+permute(std::vector<T> &v, const std::vector<int> &order)
+{
+    std::vector<T> tmp(v.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+        tmp[i] = v[order[i]];
+    }
+    v.swap(tmp);
+}
+
+static
+uint32_t
+quantize(float v, float lo, float scale, uint32_t maxValue)
+{
+    float q = (v - lo) * scale;
+    if (!(q > 0)) {
+        return 0;
+    }
+    return std::min((uint32_t)q, maxValue);
+}
+
+void
+sortRays(RayQueue &q)
+{
+    const int n = q.size();
+    if (n < 2) {
+        return;
+    }
+
+    float lo[3] = { q.ox[0], q.oy[0], q.oz[0] };
+    float hi[3] = { q.ox[0], q.oy[0], q.oz[0] };
+    for (int i = 1; i < n; ++i) {
+        lo[0] = std::min(lo[0], q.ox[i]); hi[0] = std::max(hi[0], q.ox[i]);
+        lo[1] = std::min(lo[1], q.oy[i]); hi[1] = std::max(hi[1], q.oy[i]);
+        lo[2] = std::min(lo[2], q.oz[i]); hi[2] = std::max(hi[2], q.oz[i]);
+    }
+    float scale[3];
+    for (int a = 0; a < 3; ++a) {
+        scale[a] = hi[a] > lo[a] ? 1023.0f / (hi[a] - lo[a]) : 0.0f;
+    }
+
+    std::vector<std::pair<uint64_t, int> > keys(n);
+    for (int i = 0; i < n; ++i) {
+        uint64_t octant = (q.dx[i] < 0 ? 4 : 0) | (q.dy[i] < 0 ? 2 : 0) | (q.dz[i] < 0 ? 1 : 0);
+        uint64_t origin = morton3(quantize(q.ox[i], lo[0], scale[0], 1023),
+                                  quantize(q.oy[i], lo[1], scale[1], 1023),
+                                  quantize(q.oz[i], lo[2], scale[2], 1023));
+        // directions are unit length, so [-1, 1] covers them; 64 cells per axis
+        uint64_t dir = morton3(quantize(q.dx[i], -1.0f, 31.5f, 63),
+                               quantize(q.dy[i], -1.0f, 31.5f, 63),
+                               quantize(q.dz[i], -1.0f, 31.5f, 63));
+        keys[i] = std::make_pair((octant << 48) | (origin << 18) | dir, i);
+    }
+    std::sort(keys.begin(), keys.end());
+
+    std::vector<int> order(n);
+    for (int i = 0; i < n; ++i) {
+        order[i] = keys[i].second;
+    }
+
+    permute(q.ox, order); permute(q.oy, order); permute(q.oz, order);
+    permute(q.dx, order); permute(q.dy, order); permute(q.dz, order);
+    permute(q.wr, order); permute(q.wg, order); permute(q.wb, order);
+    permute(q.tmax, order);
+    permute(q.pixel, order);
+    permute(q.sample, order);
+    permute(q.light, order);
+}
@@ -0,0 +1,34 @@
+#ifndef RAY_SORT_H
+#define RAY_SORT_H
+
+#include "RayQueue.h"
+
+#include <cstdint>
+
+// Spreads the low 10 bits of v so there are two zero bits between each.
+inline uint32_t
+spreadBits10(uint32_t v)
+{
+    v &= 0x3ff;
+    v = (v | (v << 16)) & 0x030000ff;
+    v = (v | (v << 8)) & 0x0300f00f;
+    v = (v | (v << 4)) & 0x030c30c3;
+    v = (v | (v << 2)) & 0x09249249;
+    return v;
+}
+
+// 30-bit Morton code of three 10-bit coordinates.
+inline uint32_t
+morton3(uint32_t x, uint32_t y, uint32_t z)
+{
+    return (spreadBits10(x) << 2) | (spreadBits10(y) << 1) | spreadBits10(z);
+}
+
+// Reorders the rays of q so rays with similar direction and origin are
+// adjacent: the key is the direction octant, then a Morton code of the
+// origin within the queue's bounding box, then a coarse Morton code of
+// the direction. Pixel indices travel with the rays, so results still
+// land on the right pixels.
+void sortRays(RayQueue &q);
+
+#endif // RAY_SORT_H
@@ -0,0 +1,224 @@
+#include "RenderStats.h"
+#include "TextureCache.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+
+typedef std::chrono::high_resolution_clock Clock;
+
+bool RenderStats::_enabled = false;
+
+static std::atomic<long long> totals[RenderStats::COUNTER_COUNT];
+static std::atomic<long long> phaseNanos[RenderStats::PHASE_COUNT];
+
+static const char *counterNames[RenderStats::COUNTER_COUNT] = {
+    "primary_rays", "primary_hits", "shadow_rays", "shadow_hits",
+    "reflection_rays", "reflection_hits", "octree_nodes",
+    "triangle_tests", "triangle_hits", "sphere_tests", "sphere_hits",
+    "plane_tests", "plane_hits", "transform_tests", "transform_hits",
+    "shadow_cache_tests", "shadow_cache_hits", "irradiance_lookups",
+    "irradiance_hits", "irradiance_records"
+};
+
+static const char *phaseNames[RenderStats::PHASE_COUNT] = {
+    "parse", "build", "render", "filter", "denoise", "encode"
+};
+
+static void
+addToTotals(long long *counts)
+{
+    for (int c = 0; c < RenderStats::COUNTER_COUNT; ++c) {
+        if (counts[c]) {
+            totals[c] += counts[c];
+            counts[c] = 0;
+        }
+    }
+}
+
+namespace {
+
+// Counts of one thread, flushed when the thread exits.
+struct LocalCounts
+{
+    long long counts[RenderStats::COUNTER_COUNT] = {};
+
+    ~LocalCounts() { addToTotals(counts); }
+};
+
+}
+
+long long *
+RenderStats::local()
+{
+    static thread_local LocalCounts local;
+    return local.counts;
+}
+
+void
+RenderStats::flush()
+{
+    addToTotals(local());
+}
+
+bool
+RenderStats::parseCost(const std::string &name, Cost &cost)
+{
+    if (name == "nodes") {
+        cost = COST_NODES;
+    } else if (name == "tests") {
+        cost = COST_TESTS;
+    } else if (name == "time") {
+        cost = COST_TIME;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+long long
+RenderStats::costClock(Cost cost)
+{
+    if (cost == COST_TIME) {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            Clock::now().time_since_epoch()).count();
+    }
+    const long long *counts = local();
+    if (cost == COST_NODES) {
+        return counts[OCTREE_NODES];
+    }
+    return counts[TRIANGLE_TESTS] + counts[SPHERE_TESTS] + counts[PLANE_TESTS] +
+        counts[TRANSFORM_TESTS];
+}
+
+// innermost running phase of this thread, and when it last started or
+// resumed
+static thread_local int currentPhase = -1;
+static thread_local Clock::time_point phaseStart;
+
+static void
+stopPhase(Clock::time_point now)
+{
+    if (currentPhase >= 0) {
+        phaseNanos[currentPhase] +=
+            std::chrono::duration_cast<std::chrono::nanoseconds>(now - phaseStart).count();
+    }
+    phaseStart = now;
+}
+
+RenderStats::Timer::Timer(Phase phase) : _outer(currentPhase)
+{
+    stopPhase(Clock::now());
+    currentPhase = phase;
+}
+
+RenderStats::Timer::~Timer()
+{
+    stopPhase(Clock::now());
+    currentPhase = _outer;
+}
+
+long long
+RenderStats::total(Counter c)
+{
+    return totals[c];
+}
+
+double
+RenderStats::seconds(Phase p)
+{
+    return phaseNanos[p] * 1e-9;
+}
+
+static double
+percent(long long part, long long whole)
+{
+    return whole ? 100.0 * part / whole : 0.0;
+}
+
+void
+RenderStats::print(std::ostream &out)
+{
+    out << "Render stats:\n";
+    out << "  time:";
+    double sum = 0;
+    for (int p = 0; p < PHASE_COUNT; ++p) {
+        out << (p ? ", " : " ") << phaseNames[p] << " " << seconds((Phase)p) << " s";
+        sum += seconds((Phase)p);
+    }
+    out << " (total " << sum << " s)\n";
+
+    static const char *rayNames[3] = { "primary", "shadow", "reflection" };
+    static const char *hitNames[3] = { "hit", "occluded", "hit" };
+    long long rays = 0;
+    for (int k = 0; k < 3; ++k) {
+        long long n = total((Counter)(PRIMARY_RAYS + 2 * k));
+        long long hits = total((Counter)(PRIMARY_HITS + 2 * k));
+        out << "  " << rayNames[k] << " rays: " << n << " ("
+            << percent(hits, n) << "% " << hitNames[k] << ")\n";
+        rays += n;
+    }
+    double render = seconds(RENDER);
+    out << "  all rays: " << rays;
+    if (render > 0) {
+        out << " (" << rays / render * 1e-6 << " M rays/s)";
+    }
+    out << "\n";
+    out << "  octree nodes visited: " << total(OCTREE_NODES) << " ("
+        << (rays ? (double)total(OCTREE_NODES) / rays : 0.0) << " per ray)\n";
+
+    static const char *shapeNames[4] = { "triangle", "sphere", "plane", "transform" };
+    for (int k = 0; k < 4; ++k) {
+        long long n = total((Counter)(TRIANGLE_TESTS + 2 * k));
+        long long hits = total((Counter)(TRIANGLE_HITS + 2 * k));
+        out << "  " << shapeNames[k] << " tests: " << n << " ("
+            << percent(hits, n) << "% hit, " << (rays ? (double)n / rays : 0.0)
+            << " per ray)\n";
+    }
+
+    if (total(SHADOW_CACHE_TESTS)) {
+        out << "  shadow occluder cache: " << total(SHADOW_CACHE_HITS) << " of "
+            << total(SHADOW_CACHE_TESTS) << " tests blocked the ray ("
+            << percent(total(SHADOW_CACHE_HITS), total(SHADOW_CACHE_TESTS)) << "%)\n";
+    }
+
+    if (total(IRRADIANCE_RECORDS) || total(IRRADIANCE_LOOKUPS)) {
+        out << "  irradiance cache: " << total(IRRADIANCE_RECORDS) << " records, "
+            << total(IRRADIANCE_HITS) << " of " << total(IRRADIANCE_LOOKUPS)
+            << " lookups answered ("
+            << percent(total(IRRADIANCE_HITS), total(IRRADIANCE_LOOKUPS)) << "%)\n";
+    }
+
+    long long hits, misses;
+    size_t bytes, peak;
+    TextureCache::global().stats(hits, misses, bytes, peak);
+    if (hits + misses > 0) {
+        out << "  texture cache: " << hits << " hits, " << misses << " misses ("
+            << percent(hits, hits + misses) << "% hit rate), peak " << peak / 1048576.0
+            << " of " << TextureCache::global().getBudget() / 1048576.0 << " MB\n";
+    }
+}
+
+bool
+RenderStats::writeJSON(const std::string &filename)
+{
+    FILE *file = fopen(filename.c_str(), "w");
+    if (!file) {
+        return false;
+    }
+    fprintf(file, "{\n  \"seconds\": {");
+    for (int p = 0; p < PHASE_COUNT; ++p) {
+        fprintf(file, "%s\n    \"%s\": %.6f", p ? "," : "", phaseNames[p], seconds((Phase)p));
+    }
+    fprintf(file, "\n  },\n  \"counters\": {");
+    for (int c = 0; c < COUNTER_COUNT; ++c) {
+        fprintf(file, "%s\n    \"%s\": %lld", c ? "," : "", counterNames[c], total((Counter)c));
+    }
+    long long hits, misses;
+    size_t bytes, peak;
+    TextureCache::global().stats(hits, misses, bytes, peak);
+    fprintf(file, "\n  },\n  \"texture_cache\": {\n    \"hits\": %lld,\n    \"misses\": %lld,\n"
+            "    \"peak_bytes\": %zu,\n    \"budget_bytes\": %zu\n  }\n}\n",
+            hits, misses, peak, TextureCache::global().getBudget());
+    return fclose(file) == 0;
+}
@@ -0,0 +1,129 @@
+#ifndef RENDER_STATS_H
+#define RENDER_STATS_H
+
+#include <ostream>
+#include <string>
+
+// Performance counters and phase timings of a render, reported by -stats.
+//
+// Counters are kept per thread without locks and added to shared totals
+// when the thread calls flush(), which happens on thread exit. Counting
+// is off unless enable() was called; while off, an event costs one
+// predictable branch. Phase times are always kept, since they are only
+// taken a few times per render.
+class RenderStats
+{
+public:
+    // Tests and hits come in pairs: the hit counter follows its event.
+    // A ray hits if it finds any surface (for shadow rays, an occluder);
+    // a shape test hits if it finds a surface closer than the current hit;
+    // a shadow cache test hits if the cached occluder blocks the ray; an
+    // irradiance lookup hits if cached records cover the point.
+    enum Counter {
+        PRIMARY_RAYS,
+        PRIMARY_HITS,
+        SHADOW_RAYS,
+        SHADOW_HITS,
+        REFLECTION_RAYS,
+        REFLECTION_HITS,
+        OCTREE_NODES,
+        TRIANGLE_TESTS,
+        TRIANGLE_HITS,
+        SPHERE_TESTS,
+        SPHERE_HITS,
+        PLANE_TESTS,
+        PLANE_HITS,
+        TRANSFORM_TESTS,
+        TRANSFORM_HITS,
+        SHADOW_CACHE_TESTS,
+        SHADOW_CACHE_HITS,
+        IRRADIANCE_LOOKUPS,
+        IRRADIANCE_HITS,
+        IRRADIANCE_RECORDS,
+        COUNTER_COUNT
+    };
+
+    enum Phase {
+        PARSE,
+        BUILD,
+        RENDER,
+        FILTER,
+        DENOISE,
+        ENCODE,
+        PHASE_COUNT
+    };
+
+    // Turns counting on or off. Call it before render threads start.
+    static void enable(bool on) { _enabled = on; }
+    static bool enabled() { return _enabled; }
+
+    // Adds n to counter c of the calling thread.
+    static void count(Counter c, long long n = 1)
+    {
+        if (_enabled) {
+            local()[c] += n;
+        }
+    }
+
+    // Counts one event c, and a hit of it (counter c + 1) if hit is set.
+    static void record(Counter c, bool hit)
+    {
+        if (_enabled) {
+            long long *counts = local();
+            ++counts[c];
+            counts[c + 1] += hit;
+        }
+    }
+
+    // Adds the calling thread's counts to the totals and resets them.
+    static void flush();
+
+    // Measures of the work spent on a pixel, for the cost map.
+    enum Cost {
+        COST_NODES,
+        COST_TESTS,
+        COST_TIME,
+    };
+
+    // Look up a cost measure by name: nodes (octree nodes visited), tests
+    // (shape intersection tests) or time (nanoseconds).
+    // Returns false if the name is unknown.
+    static bool parseCost(const std::string &name, Cost &cost);
+
+    // Work done on the calling thread so far, in units of cost; the cost
+    // of a pixel is the difference between readings before and after it.
+    // nodes and tests only advance while counting is enabled, and between
+    // flushes.
+    static long long costClock(Cost cost);
+
+    // Adds the wall time from construction to destruction to a phase.
+    // Timers on one thread nest: an inner phase's time is not counted
+    // in the outer one.
+    class Timer
+    {
+    public:
+        explicit Timer(Phase phase);
+        ~Timer();
+
+    private:
+        int _outer;
+    };
+
+    // Counter totals flushed so far and seconds spent in each phase.
+    static long long total(Counter c);
+    static double seconds(Phase p);
+
+    // Human-readable report of the totals.
+    static void print(std::ostream &out);
+
+    // The totals as a JSON object. Returns false if the file could not be
+    // written.
+    static bool writeJSON(const std::string &filename);
+
+private:
+    static long long *local();
+
+    static bool _enabled;
+};
+
+#endif // RENDER_STATS_H
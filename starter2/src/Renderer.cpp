@@ -2,17 +2,73 @@
 
 #include "ArgParser.h"
 #include "Camera.h"
+#include "CubeMap.h"
+#include "Denoiser.h"
+#include "Filter.h"
 #include "Image.h"
+#include "LayerFile.h"
 #include "Ray.h"
+#include "RenderStats.h"
+#include "Sampler.h"
+#include "ShadowCache.h"
+#include "TextureCache.h"
 #include "VecUtils.h"
 
+#include <algorithm>
+#include <cmath>
+#include <iostream>
 #include <limits>
 
 #define eps 1e-4f
 
 Renderer::Renderer(const ArgParser &args) : _args(args),
-                                            _scene(args.input_file)
+                                            _scene(args.input_file),
+                                            _lights(_scene),
+                                            _irradianceCache(1.5f * args.ic_error),
+                                            _aovs(0),
+                                            _pixelOrder(PixelOrder::SCANLINE),
+                                            _cost(RenderStats::COST_NODES),
+                                            _depthRange(args.depth_max - args.depth_min),
+                                            _pixelSpread(0)
 {
+    PixelOrder::parseType(_args.pixel_order, _pixelOrder);
+    RenderStats::parseCost(_args.cost_metric, _cost);
+    TextureCache::global().setBudget((size_t)_args.texture_cache << 20);
+    CubeMap::setCacheDirectory(_args.texture_cache_dir);
+    Image::setPNGCompression(_args.png_compression);
+    RenderStats::enable(_args.stats || _args.stats_file.size() || _args.cost_file.size());
+
+    _aovFiles[AOV_COLOR] = _args.output_file;
+    _aovFiles[AOV_NORMAL] = _args.normals_file;
+    _aovFiles[AOV_DEPTH] = _args.depth_file;
+    _aovFiles[AOV_OBJECT_ID] = _args.objectid_file;
+    _aovFiles[AOV_MATERIAL_ID] = _args.materialid_file;
+    _aovFiles[AOV_HIT_COUNT] = _args.hitcount_file;
+    _aovFiles[AOV_COST] = _args.cost_file;
+
+    // only the outputs that were asked for are computed
+    for (int a = 0; a < AOV_COUNT; ++a) {
+        if (_aovFiles[a].size()) {
+            _aovs |= aovBit((AOV)a);
+        }
+    }
+
+    // the layer file always holds color, normal and depth
+    if (_args.layers_file.size()) {
+        _aovs |= aovBit(AOV_COLOR) | aovBit(AOV_NORMAL) | aovBit(AOV_DEPTH);
+    }
+
+    // cost is measured per pixel, which ray batches and tiles of paths
+    // do not have
+    if ((_aovs & aovBit(AOV_COST)) && (_args.path_trace || _args.wavefront)) {
+        std::cout << "Warning: -cost is only measured by Whitted sampling\n";
+        _aovs &= ~aovBit(AOV_COST);
+    }
+
+    // the denoiser uses normals and depth as edge-stopping guides
+    if (_args.denoise && (_aovs & aovBit(AOV_COLOR))) {
+        _aovs |= aovBit(AOV_NORMAL) | aovBit(AOV_DEPTH);
+    }
 }
 
 
@@ -21,228 +77,567 @@ void Renderer::Render()
     int w = _args.width;
     int h = _args.height;
 
-    Image image(w, h);
-    Image nimage(w, h);
-    Image dimage(w, h);
-
-    if (!_args.jitter && !_args.filter){
-        // no super-sampling
-        vanillaSampling(w, h, image, nimage, dimage);
+    if (_args.bench_sort){
+        benchmarkRaySort(w, h);
+        return;
     }
 
-    else if (_args.filter){
+    FrameBuffer fb;
+
+    if (!_args.filter){
+        // no super-sampling. Whitted sampling writes each pixel once and
+        // saves it unchanged, so 8-bit storage loses nothing unless float
+        // files are written; path tracing and wavefront tracing add to
+        // pixels, and the denoiser reads float colors.
+        bool compact = !_args.denoise && !_args.path_trace && !_args.wavefront &&
+            !_args.layers_file.size() && !(_aovs & aovBit(AOV_COST));
+        for (int a = 0; a < AOV_COUNT; ++a) {
+            compact = compact && !Image::isPFM(_aovFiles[a]);
+        }
+        fb = FrameBuffer(w, h, _aovs, compact ? Image::UINT8 : Image::FLOAT32);
+        RenderStats::Timer timer(RenderStats::RENDER);
+        sampleImage(w, h, fb);
+    }
+    else{
         // filter
-        int super_w = w * 3;
-        int super_h = h * 3;
+        int super_w = w * _args.supersample;
+        int super_h = h * _args.supersample;
 
-        Image superImage(super_w, super_h);
-        Image superNImage(super_w, super_h);
-        Image superDImage(super_w, super_h);
-
-        // filter + jitter
-        if (_args.jitter){
-            jitteredSampling(super_w, super_h,
-                superImage, superNImage, superDImage);
-        }
-        else{
-            vanillaSampling(super_w, super_h,
-                superImage, superNImage, superDImage);
+        FrameBuffer superFb(super_w, super_h, _aovs);
+        {
+            RenderStats::Timer timer(RenderStats::RENDER);
+            sampleImage(super_w, super_h, superFb);
         }
-        
-        image = ApplyGaussianFilter(superImage, w, h);
-        nimage = ApplyGaussianFilter(superNImage, w, h);
-        dimage = ApplyGaussianFilter(superDImage, w, h);
-    }
-    // jitter
-    else if (_args.jitter){
-        jitteredSampling(w, h, image, nimage, dimage);
+
+        RenderStats::Timer timer(RenderStats::FILTER);
+        fb = superFb.filtered(reconstructionFilter(), w, h);
     }
 
-    // save the files
-    if (_args.output_file.size())
-    {
-        image.savePNG(_args.output_file);
+    if (_args.denoise && fb.has(AOV_COLOR)){
+        RenderStats::Timer timer(RenderStats::DENOISE);
+        Denoiser denoiser;
+        fb.getImage(AOV_COLOR) = denoiser.denoise(fb.getImage(AOV_COLOR),
+            fb.getImage(AOV_NORMAL), fb.getImage(AOV_DEPTH));
     }
-    if (_args.depth_file.size())
+
+    // save the files, encoding them all at once
     {
-        dimage.savePNG(_args.depth_file);
+        RenderStats::Timer timer(RenderStats::ENCODE);
+        for (int a = 0; a < AOV_COUNT; ++a) {
+            if (fb.has((AOV)a) && _aovFiles[a].size() && a != AOV_COST) {
+                _writer.save(fb.getImage((AOV)a), _aovFiles[a]);
+            }
+        }
+        if (fb.has(AOV_COST)) {
+            saveCostMap(fb.getImage(AOV_COST));
+        }
+        if (_args.layers_file.size()) {
+            static const char *names[AOV_COUNT] = {
+                "color", "normal", "depth", "objectid", "materialid", "hitcount", "cost"
+            };
+            static const int channels[AOV_COUNT] = { 3, 3, 1, 3, 3, 1, 1 };
+            std::vector<LayerFile::Layer> layers;
+            for (int a = 0; a < AOV_COUNT; ++a) {
+                if (fb.has((AOV)a)) {
+                    LayerFile::Layer layer = { names[a], channels[a], &fb.getImage((AOV)a) };
+                    layers.push_back(layer);
+                }
+            }
+            if (!LayerFile::write(_args.layers_file, layers,
+                                  _args.layers_half ? Image::FLOAT16 : Image::FLOAT32)) {
+                std::cout << "Error: could not write " << _args.layers_file << "\n";
+            }
+        }
+        _writer.wait();
     }
-    if (_args.normals_file.size())
-    {
-        nimage.savePNG(_args.normals_file);
+
+    if (RenderStats::enabled()){
+        // worker threads flushed their counts when they exited
+        RenderStats::flush();
+        if (_args.stats){
+            RenderStats::print(std::cout);
+        }
+        if (_args.stats_file.size() && !RenderStats::writeJSON(_args.stats_file)){
+            std::cout << "Error: could not write " << _args.stats_file << "\n";
+        }
     }
 }
 
-Vector3f
-Renderer::traceRay(const Ray &r,    
-                   float tmin,
-                   int bounces,
-                   Hit &h) const
+/**
+ * False color for t in [0, 1], from black through purple, red and orange
+ * to pale yellow (stops of the inferno color map), so brighter is more.
+ */
+static Vector3f heatColor(float t)
 {
-    if (_scene.getGroup()->intersect(r, tmin, h))
-    {
-        Material *material = h.getMaterial();
-        Vector3f hitPoint = r.pointAtParameter(h.getT());
-        Vector3f normal = h.getNormal().normalized();
-        Vector3f finalColor = Vector3f::ZERO;
+    static const Vector3f stops[5] = {
+        Vector3f(0.001f, 0.000f, 0.014f),
+        Vector3f(0.341f, 0.062f, 0.429f),
+        Vector3f(0.735f, 0.216f, 0.330f),
+        Vector3f(0.978f, 0.557f, 0.035f),
+        Vector3f(0.988f, 0.998f, 0.645f),
+    };
+    t = std::min(std::max(t, 0.0f), 1.0f) * 4;
+    int i = std::min((int)t, 3);
+    float f = t - i;
+    return (1 - f) * stops[i] + f * stops[i + 1];
+}
 
-        finalColor += _scene.getAmbientLight() * material->getDiffuseColor();
+Filter Renderer::reconstructionFilter() const
+{
+    Filter::Type type;
+    Filter::parseType(_args.filter_kernel, type);
+    return Filter(type, _args.filter_radius);
+}
 
-        for (int i = 0; i < _scene.getNumLights(); ++i)
-        {
-            Light *light = _scene.getLight(i);
-            Vector3f dirToLight;
-            Vector3f lightIntensity;
-            float distToLight;
-
-            light->getIllumination(hitPoint, dirToLight, lightIntensity, distToLight);
-
-            // shadow 
-            if (_args.shadows){
-                Ray shadowRay(hitPoint + eps * dirToLight, dirToLight);
-                Hit shadowHit;
-
-                if (_scene.getGroup()->intersect(shadowRay, tmin, shadowHit)){
-                    if (shadowHit.getT() < distToLight){
-                        continue;
-                    }
-                }
-            }
+/**
+ * Writes the per-pixel cost as raw floats to a PFM file and as a
+ * false-color PNG, both named after _args.cost_file. The PNG is scaled
+ * so that the 99th percentile of the costs gets the hottest color, which
+ * keeps a few outliers from washing out the rest of the map. With -stats
+ * that scale is printed too.
+ */
+void Renderer::saveCostMap(const Image& cost)
+{
+    std::string base = _args.cost_file;
+    size_t dot = base.find_last_of('.');
+    if (dot != std::string::npos && base.find_first_of("\\/", dot) == std::string::npos){
+        base = base.substr(0, dot);
+    }
+    _writer.savePFM(cost, base + ".pfm");
 
-            finalColor += material->shade(r, h, dirToLight, lightIntensity);
-        }
+    const int w = cost.getWidth();
+    const int h = cost.getHeight();
+    std::vector<float> values((size_t)w * h);
+    for (int y = 0; y < h; ++y){
+        const float* row = cost.getRow(0, y);
+        std::copy(row, row + w, values.begin() + (size_t)y * w);
+    }
+    std::vector<float> sorted = values;
+    std::vector<float>::iterator p99 = sorted.begin() + (sorted.size() - 1) * 99 / 100;
+    std::nth_element(sorted.begin(), p99, sorted.end());
+    const float maxCost = *std::max_element(p99, sorted.end());
+    const float scale = *p99 > 0 ? *p99 : (maxCost > 0 ? maxCost : 1.0f);
 
-        // Reflection
-        if (bounces > 0)
-        {
-            Vector3f incident = r.getDirection().normalized();
-            Vector3f reflectDir = incident - 2 * Vector3f::dot(incident, normal) * normal;
-            reflectDir.normalize();
+    Image heat(w, h, Image::UINT8);
+    for (int y = 0; y < h; ++y){
+        for (int x = 0; x < w; ++x){
+            heat.setPixel(x, y, heatColor(values[(size_t)y * w + x] / scale));
+        }
+    }
+    _writer.savePNG(heat, base + ".png");
 
-            Ray reflectRay(hitPoint + eps * reflectDir, reflectDir);
+    if (_args.stats){
+        static const char *units[3] = { "octree nodes", "shape tests", "ns" };
+        std::cout << "Cost map: " << *p99 << " " << units[_cost]
+            << " per pixel at the 99th percentile, " << maxCost << " at most\n";
+    }
+}
 
-            Hit reflectedHit;
-            Vector3f reflectedColor = traceRay(reflectRay, tmin, bounces - 1, reflectedHit);
+#define SAMPLING_KERNEL(jitter, shade, shadows, reflect) \
+    &Renderer::samplingKernel<jitter, shade, shadows, reflect>
 
-            finalColor += material->getSpecularColor() * reflectedColor;
-        }
+/**
+ * Fills fb with samples. The per-sample kernel is a template over the
+ * feature set (jitter, shading, shadows, reflections); the matching
+ * instantiation is picked once here, so the inner loops carry no checks
+ * for those features when they are off.
+ *
+ * The other outputs and options stay runtime checks: the AOVs besides
+ * color (tested against _aovs once per camera sample, in sampleRay,
+ * primaryAOVs and the jittered sum), the depth range and light picking
+ * (once per hit). Each is one predictable branch on a value fixed for the
+ * render, set against a scene traversal per ray; making the AOV mask a
+ * template parameter as well would multiply the 16 kernels by up to 128.
+ */
+void Renderer::sampleImage(int w, int h, FrameBuffer& fb)
+{
+    // each of several samples per pixel stands for a part of the pixel
+    int samples = (_args.jitter || _args.path_trace) ? _args.samples : 1;
+    _pixelSpread = pixelAngle(w) / std::sqrt((float)samples);
 
-        return finalColor;
+    if (_args.path_trace){
+        pathTraceSampling(w, h, fb);
+        return;
     }
-    else
-    {
-        return _scene.getBackgroundColor(r.getDirection());
+    if (_args.wavefront){
+        wavefrontSampling(w, h, fb);
+        return;
     }
+
+    typedef void (Renderer::*Kernel)(int, int, FrameBuffer&);
+    // indexed by [jitter][shade][shadows][reflect]
+    static const Kernel kernels[2][2][2][2] = {
+        { { { SAMPLING_KERNEL(false, false, false, false), SAMPLING_KERNEL(false, false, false, true) },
+            { SAMPLING_KERNEL(false, false, true, false),  SAMPLING_KERNEL(false, false, true, true) } },
+          { { SAMPLING_KERNEL(false, true, false, false),  SAMPLING_KERNEL(false, true, false, true) },
+            { SAMPLING_KERNEL(false, true, true, false),   SAMPLING_KERNEL(false, true, true, true) } } },
+        { { { SAMPLING_KERNEL(true, false, false, false),  SAMPLING_KERNEL(true, false, false, true) },
+            { SAMPLING_KERNEL(true, false, true, false),   SAMPLING_KERNEL(true, false, true, true) } },
+          { { SAMPLING_KERNEL(true, true, false, false),   SAMPLING_KERNEL(true, true, false, true) },
+            { SAMPLING_KERNEL(true, true, true, false),    SAMPLING_KERNEL(true, true, true, true) } } },
+    };
+
+    bool shade = (_aovs & aovBit(AOV_COLOR)) != 0;
+    bool reflect = _args.bounces > 0;
+    Kernel kernel = kernels[_args.jitter][shade][_args.shadows][reflect];
+    (this->*kernel)(w, h, fb);
+}
+
+#undef SAMPLING_KERNEL
+
+float Renderer::pixelAngle(int w) const
+{
+    Camera* cam = _scene.getCamera();
+    Vector3f d0 = cam->generateRay(Vector2f(0, 0)).getDirection().normalized();
+    Vector3f d1 = cam->generateRay(Vector2f(2.0f / w, 0)).getDirection().normalized();
+    return (d1 - d0).abs();
 }
 
 /**
- * Applies Gaussian filter to a super sampled image.
- * Assumes img is a super-sampled image.
- * Returns downsampled image with resolution (w, h).
+ * Ambient plus direct Phong lighting from every light at a hit point,
+ * with shadow rays if Shadows is set. pick, uniform in [0, 1), chooses the
+ * light with _args.light_pick.
  */
-Image Renderer::ApplyGaussianFilter(const Image& img, int w, int h){
-    Image result(w, h);
-    float kernel[3][3] = { {1,2,1}, {2,4,2}, {1,2,1} };
-    float kernelSum = 16.0f;
+template<bool Shadows>
+Vector3f
+Renderer::directLighting(const Ray &r,
+                         const Hit &h,
+                         float tmin,
+                         float pick) const
+{
+    static thread_local LightSample lights;
 
-    for (int y = 0; y < h; ++y){
-        for (int x = 0; x < w; ++x){
-            Vector3f blurred = Vector3f::ZERO;
+    Material *material = h.getMaterial();
+    Vector3f hitPoint = r.pointAtParameter(h.getT());
+    Vector3f color = _scene.getAmbientLight() * material->getDiffuseColor();
 
-            for (int dy = -1; dy <= 1; ++dy){
-                for (int dx = -1; dx <= 1; ++dx){
-                    int sx = clamp(x * 3 + dx, 0, img.getWidth() - 1);
-                    int sy = clamp(y * 3 + dy, 0, img.getHeight() - 1);
+    if (_args.light_pick){
+        _lights.illuminateOne(hitPoint, pick, lights);
+    }
+    else{
+        _lights.illuminate(hitPoint, _args.light_cutoff, lights);
+    }
+    material->shade(r, h, lights);
+    if (Shadows){
+        shadowMask(hitPoint, tmin, lights);
+    }
 
-                    blurred += img.getPixel(sx, sy) * kernel[dy + 1][dx + 1];
-                }
-            }
+    // accumulate in scene order so the sum does not depend on the lanes
+    for (int l : lights.order)
+    {
+        if (!Shadows || lights.visible[l]){
+            color += lights.getContribution(l);
+        }
+    }
+    return color;
+}
 
-            result.setPixel(x, y, blurred / kernelSum);
+/**
+ * Traces the shadow rays of every light of s in one batch. Lights that
+ * contribute nothing at point are skipped, and each ray only looks for
+ * occluders closer than its light. The primitive that last blocked a
+ * light on this thread is tested first; only if it misses is the scene
+ * traversed.
+ */
+void
+Renderer::shadowMask(const Vector3f &point,
+                     float tmin,
+                     LightSample &s) const
+{
+    ShadowCache &cache = ShadowCache::local(_scene.getGroup());
+
+    for (int l = 0; l < s.size(); ++l)
+    {
+        if (s.isBlack(l)){
+            s.visible[l] = 0;
+            continue;
         }
+        const Vector3f dirToLight = s.getDirection(l);
+        Ray shadowRay(point + eps * dirToLight, dirToLight);
+        s.visible[l] = !cache.occluded(s.light[l], shadowRay, tmin, s.dist[l]);
     }
+}
 
-    return result;
+/**
+ * Scales throughput by the specular color of the surface a path is about
+ * to reflect off. Returns false when the path should stop: its throughput
+ * is zero, or it is below _args.rr_threshold and lost the Russian
+ * roulette, played with u uniform in [0, 1). Survivors are reweighted by
+ * their survival probability.
+ */
+bool
+Renderer::continuePath(const Material &material, Vector3f &throughput, float u) const
+{
+    throughput = throughput * material.getSpecularColor();
+    float weight = std::max(throughput[0], std::max(throughput[1], throughput[2]));
+    if (weight <= 0){
+        return false;
+    }
+    if (weight < _args.rr_threshold){
+        float survive = weight / _args.rr_threshold;
+        if (u >= survive){
+            return false;
+        }
+        throughput = throughput / survive;
+    }
+    return true;
 }
 
-float Renderer::clamp (float x, float min, float max){
-    if (x < min) return min;
-    if (x > max) return max;
-    return x;
+/**
+ * Mirror reflection of r about the normal at hit h, offset off the surface.
+ */
+Ray
+Renderer::reflectRay(const Ray &r, const Hit &h)
+{
+    Vector3f hitPoint = r.pointAtParameter(h.getT());
+    Vector3f normal = h.getNormal().normalized();
+    Vector3f incident = r.getDirection().normalized();
+    Vector3f reflectDir = incident - 2 * Vector3f::dot(incident, normal) * normal;
+    reflectDir.normalize();
+
+    return Ray(hitPoint + eps * reflectDir, reflectDir);
 }
 
+/**
+ * Whitted-style tracing of the mirror reflection chain, done iteratively.
+ * The product of specular colors along the path is carried as a
+ * throughput weight. Paths with zero throughput stop; paths whose
+ * throughput falls below _args.rr_threshold go through Russian roulette,
+ * and survivors are reweighted so the estimate stays unbiased. The
+ * random choices at each hit come from PixelSampler::vertex of sample s
+ * of pixel. h receives the primary hit. Without Reflect only the primary
+ * hit is shaded.
+ */
+template<bool Shadows, bool Reflect>
+Vector3f
+Renderer::traceRay(const Ray &r,    
+                   float tmin,
+                   int bounces,
+                   int pixel,
+                   int s,
+                   Hit &h,
+                   int &hitCount) const
+{
+    Vector3f color = Vector3f::ZERO;
+    Vector3f throughput(1.0f);
+    Ray ray = r;
+    Hit bounceHit;
+    Hit *hit = &h;
 
-void Renderer::vanillaSampling(int w, int h,
-                                Image& image, Image& nimage, Image& dimage){
+    for (int depth = 0; ; ++depth)
+    {
+        bool found = _scene.getGroup()->intersect(ray, tmin, *hit);
+        RenderStats::record(depth ? RenderStats::REFLECTION_RAYS : RenderStats::PRIMARY_RAYS, found);
+        if (!found)
+        {
+            // mirror reflections off flat surfaces keep the cone of the
+            // camera ray
+            color += throughput * _scene.getBackgroundColor(ray.getDirection(), _pixelSpread);
+            break;
+        }
 
-    Camera* cam = _scene.getCamera();
+        ++hitCount;
+        // drawn in this order by the wavefront shader too
+        PixelSampler sampler = PixelSampler::vertex(pixel, s, depth);
+        float pick = sampler.next();
+        color += throughput * directLighting<Shadows>(ray, *hit, tmin, pick);
 
-    for (int y = 0; y < h; ++y){
+        // Reflection
+        if (!Reflect || depth >= bounces){
+            break;
+        }
 
-        float ndcy = 2 * (y / (h - 1.0f)) - 1.0f;
+        if (!continuePath(*hit->getMaterial(), throughput, sampler.next())){
+            break;
+        }
 
-        for (int x = 0; x < w; ++x){
-            
-            float ndcx = 2 * (x / (w - 1.0f)) - 1.0f;
-            Ray r = cam->generateRay(Vector2f(ndcx, ndcy));
+        ray = reflectRay(ray, *hit);
+        bounceHit = Hit();
+        hit = &bounceHit;
+    }
 
-            Hit h;
-            Vector3f color = traceRay(r, cam->getTMin(), _args.bounces, h);
+    return color;
+}
 
-            image.setPixel(x, y, color);
-            nimage.setPixel(x, y, (h.getNormal() + 1.0f) / 2.0f);
-            float range = (_args.depth_max - _args.depth_min);
-            if (range){
-                dimage.setPixel(x, y, Vector3f((h.t - _args.depth_min) / range));
-            }
+/**
+ * Maps an index to a stable, well separated color. -1 (no hit) maps to black.
+ */
+static Vector3f idColor(int id)
+{
+    if (id < 0){
+        return Vector3f::ZERO;
+    }
+    unsigned int hash = (unsigned int)(id + 1) * 2654435761u;
+    return Vector3f(((hash >> 0) & 255) / 255.0f,
+                    ((hash >> 8) & 255) / 255.0f,
+                    ((hash >> 16) & 255) / 255.0f);
+}
+
+int Renderer::materialIndex(const Material* material) const
+{
+    for (int i = 0; i < _scene.getNumMaterials(); ++i){
+        if (_scene.getMaterial(i) == material){
+            return i;
         }
     }
+    return -1;
 }
 
 /**
- * Jittered sampling. Samples 16 rays per pixel, each with a random offset.
+ * Traces a camera ray and fills in the requested AOVs. Without Shade (no
+ * color output requested), shading and secondary rays are skipped and
+ * only the primary intersection is computed.
  */
-void Renderer::jitteredSampling(int w, int h,
-                                 Image& image, Image& nimage, Image& dimage){
-    
+template<bool Shade, bool Shadows, bool Reflect>
+void Renderer::sampleRay(const Ray& r, int pixel, int s, AOVSample& sample) const
+{
     Camera* cam = _scene.getCamera();
-    int samples = 16;
+    Hit h;
+    int hitCount = 0;
 
-    for (int y = 0; y < w; ++y){
-        for (int x = 0; x < h; ++x){
+    if (Shade){
+        sample.value[AOV_COLOR] = traceRay<Shadows, Reflect>(r, cam->getTMin(),
+            _args.bounces, pixel, s, h, hitCount);
+    }
+    else{
+        hitCount = _scene.getGroup()->intersect(r, cam->getTMin(), h) ? 1 : 0;
+        RenderStats::record(RenderStats::PRIMARY_RAYS, hitCount > 0);
+    }
 
-            Vector3f color_sum = Vector3f::ZERO;
-            Vector3f normal_sum = Vector3f::ZERO;
-            Vector3f depth_sum = Vector3f::ZERO;
+    primaryAOVs(h, sample);
+    if (_aovs & aovBit(AOV_HIT_COUNT)){
+        sample.value[AOV_HIT_COUNT] = Vector3f(hitCount / (_args.bounces + 1.0f));
+    }
+}
 
-            for (int s = 0; s < samples; ++s){
-                
-                float jitter_x = (rand() / (float) RAND_MAX) - 0.5f; 
-                float jitter_y = (rand() / (float) RAND_MAX) - 0.5f; 
+/**
+ * Fills in the AOVs that only depend on the primary hit: normal, depth,
+ * object ID and material ID.
+ */
+void Renderer::primaryAOVs(const Hit& h, AOVSample& sample) const
+{
+    if (_aovs & aovBit(AOV_NORMAL)){
+        sample.value[AOV_NORMAL] = (h.getNormal() + 1.0f) / 2.0f;
+    }
+    if (_aovs & aovBit(AOV_DEPTH)){
+        sample.value[AOV_DEPTH] = _depthRange ? Vector3f((h.t - _args.depth_min) / _depthRange)
+                                              : Vector3f::ZERO;
+    }
+    if (_aovs & aovBit(AOV_OBJECT_ID)){
+        sample.value[AOV_OBJECT_ID] = idColor(h.object);
+    }
+    if (_aovs & aovBit(AOV_MATERIAL_ID)){
+        sample.value[AOV_MATERIAL_ID] = idColor(h.material ? materialIndex(h.material) : -1);
+    }
+}
 
-                float ndcx = 2 * ((x + 0.5f + jitter_x) / w) - 1.0f;
-                float ndcy = 2 * ((y + 0.5f + jitter_y) / h) - 1.0f;
+/**
+ * Calls f(x, y) for every pixel of a w x h image. With a space-filling
+ * _args.pixel_order, the image is walked tile by tile, with both the
+ * tiles and the pixels inside each tile following the curve.
+ */
+template<typename F>
+void Renderer::forEachPixel(int w, int h, const F& f) const
+{
+    if (_pixelOrder == PixelOrder::SCANLINE){
+        for (int y = 0; y < h; ++y){
+            for (int x = 0; x < w; ++x){
+                f(x, y);
+            }
+        }
+        return;
+    }
 
-                Ray r = cam->generateRay(Vector2f(ndcx, ndcy));
-                Hit hit;
-                Vector3f color = traceRay(r, cam->getTMin(), _args.bounces, hit);
+    const int tile = _args.tile_size;
+    const int tilesX = (w + tile - 1) / tile;
+    const int tilesY = (h + tile - 1) / tile;
+    std::vector<int> tiles;
+    std::vector<int> pixels;
+    PixelOrder::generate(_pixelOrder, tilesX, tilesY, tiles);
+
+    for (int t : tiles){
+        int x0 = (t % tilesX) * tile;
+        int y0 = (t / tilesX) * tile;
+        int tw = std::min(tile, w - x0);
+        int th = std::min(tile, h - y0);
+        PixelOrder::generate(_pixelOrder, tw, th, pixels);
+        for (int p : pixels){
+            f(x0 + p % tw, y0 + p / tw);
+        }
+    }
+}
 
-                color_sum += color;
-                normal_sum += (hit.getNormal() + 1.0f) / 2.0f;
+template<bool Shade, bool Shadows, bool Reflect>
+void Renderer::vanillaSampling(int w, int h, FrameBuffer& fb){
 
-                float range = (_args.depth_max - _args.depth_min);
-                if (range){
-                    depth_sum += Vector3f((hit.t - _args.depth_min) / range);
-                }
-            }
+    Camera* cam = _scene.getCamera();
+    const bool cost = (_aovs & aovBit(AOV_COST)) != 0;
+    AOVSample sample;
+
+    forEachPixel(w, h, [&](int x, int y){
+        long long start = cost ? RenderStats::costClock(_cost) : 0;
+        float ndcx = 2 * (x / (w - 1.0f)) - 1.0f;
+        float ndcy = 2 * (y / (h - 1.0f)) - 1.0f;
+        Ray r = cam->generateRay(Vector2f(ndcx, ndcy));
 
-            image.setPixel(x, y, color_sum / samples);
-            nimage.setPixel(x, y, normal_sum / samples);
+        sampleRay<Shade, Shadows, Reflect>(r, y * w + x, 0, sample);
+        if (cost){
+            sample.value[AOV_COST] = Vector3f((float)(RenderStats::costClock(_cost) - start));
+        }
+        fb.addSample(x, y, sample);
+    });
+}
 
-            float range = _args.depth_max - _args.depth_min;
-            if (range > 0){
-                dimage.setPixel(x, y, depth_sum);
+/**
+ * Jittered sampling. Samples _args.samples rays per pixel, each with a
+ * random offset.
+ */
+template<bool Shade, bool Shadows, bool Reflect>
+void Renderer::jitteredSampling(int w, int h, FrameBuffer& fb){
+    
+    Camera* cam = _scene.getCamera();
+    int samples = _args.samples;
+    const bool cost = (_aovs & aovBit(AOV_COST)) != 0;
+    AOVSample sample;
+    AOVSample pixel;
+
+    // samples are summed here, so each pixel of fb is written once
+    forEachPixel(w, h, [&](int x, int y){
+        long long start = cost ? RenderStats::costClock(_cost) : 0;
+        for (int a = 0; a < AOV_COUNT; ++a){
+            pixel.value[a] = Vector3f::ZERO;
+        }
+        for (int s = 0; s < samples; ++s){
+            
+            float jitter_x = (rand() / (float) RAND_MAX) - 0.5f; 
+            float jitter_y = (rand() / (float) RAND_MAX) - 0.5f; 
+
+            float ndcx = 2 * ((x + 0.5f + jitter_x) / w) - 1.0f;
+            float ndcy = 2 * ((y + 0.5f + jitter_y) / h) - 1.0f;
+
+            Ray r = cam->generateRay(Vector2f(ndcx, ndcy));
+            sampleRay<Shade, Shadows, Reflect>(r, y * w + x, s, sample);
+            for (int a = 0; a < AOV_COUNT; ++a){
+                if (_aovs & aovBit((AOV)a)){
+                    pixel.value[a] += (1.0f / samples) * sample.value[a];
+                }
             }
         }
+        // the cost of all the samples of the pixel
+        if (cost){
+            pixel.value[AOV_COST] = Vector3f((float)(RenderStats::costClock(_cost) - start));
+        }
+        fb.addSample(x, y, pixel);
+    });
+}
+
+template<bool Jitter, bool Shade, bool Shadows, bool Reflect>
+void Renderer::samplingKernel(int w, int h, FrameBuffer& fb)
+{
+    if (Jitter){
+        jitteredSampling<Shade, Shadows, Reflect>(w, h, fb);
+    }
+    else{
+        vanillaSampling<Shade, Shadows, Reflect>(w, h, fb);
     }
 }
@@ -2,13 +2,22 @@
 #define RENDERER_H
 
 #include <string>
+#include <vector>
 
 #include "SceneParser.h"
 #include "ArgParser.h"
+#include "FrameBuffer.h"
+#include "ImageWriter.h"
+#include "IrradianceCache.h"
+#include "LightSet.h"
+#include "PixelOrder.h"
+#include "RenderStats.h"
 
+class Filter;
 class Hit;
 class Vector3f;
 class Ray;
+class PixelSampler;
 
 class Renderer{
 public:
@@ -16,21 +25,98 @@ public:
 	Renderer(const ArgParser& args);
 	void Render();
 private:
-	Vector3f traceRay(const Ray& ray, float tmin, int bounces,
-		Hit& hit) const;
+	// Picks the sampling kernel for the enabled features and runs it.
+	void sampleImage(int w, int h, FrameBuffer& fb);
 
-	Image ApplyGaussianFilter(const Image& img, int w, int h);
+	// Angle between the camera rays of neighboring pixels, near the
+	// center of a w pixels wide image.
+	float pixelAngle(int w) const;
 
-	float clamp(float x, float min, float max);
+	// s is the index of the sample in pixel, which seeds the random
+	// choices along the path.
+	template<bool Shadows, bool Reflect>
+	Vector3f traceRay(const Ray& ray, float tmin, int bounces, int pixel, int s,
+		Hit& hit, int& hitCount) const;
+
+	template<bool Shadows>
+	Vector3f directLighting(const Ray& ray, const Hit& hit, float tmin, float pick) const;
+
+	// Sets s.visible for every light of s, as seen from point.
+	void shadowMask(const Vector3f& point, float tmin, LightSample& s) const;
+
+	bool continuePath(const Material& material, Vector3f& throughput, float u) const;
+
+	static Ray reflectRay(const Ray& ray, const Hit& hit);
+
+	// Traces one camera ray and fills in the AOVs enabled in _aovs.
+	template<bool Shade, bool Shadows, bool Reflect>
+	void sampleRay(const Ray& ray, int pixel, int s, AOVSample& sample) const;
+
+	void primaryAOVs(const Hit& hit, AOVSample& sample) const;
+
+	int materialIndex(const Material* material) const;
+
+	template<typename F>
+	void forEachPixel(int w, int h, const F& f) const;
+
+	template<bool Shade, bool Shadows, bool Reflect>
+	void vanillaSampling(int w, int h, FrameBuffer& fb);
+
+	template<bool Shade, bool Shadows, bool Reflect>
+	void jitteredSampling(int w, int h, FrameBuffer& fb);
+
+	template<bool Jitter, bool Shade, bool Shadows, bool Reflect>
+	void samplingKernel(int w, int h, FrameBuffer& fb);
+
+	// Path tracing mode: global illumination with next-event estimation.
+	void pathTraceSampling(int w, int h, FrameBuffer& fb);
+
+	Vector3f tracePath(const Ray& ray, float tmin, int bounces, float spread, PixelSampler& sampler,
+		const IrradianceCache* cache, Hit& hit, int& hitCount) const;
+
+	Vector3f sampleLights(const Ray& ray, const Hit& hit, float tmin,
+		PixelSampler& sampler) const;
+
+	// Fills _irradianceCache from the primary hits of the image.
+	void buildIrradianceCache(int w, int h, const std::vector<int>& tiles, int tilesX);
+
+	void irradianceRecord(const Vector3f& p, const Vector3f& n, float tmin,
+		float footprint, PixelSampler& sampler, IrradianceRecord& record) const;
+
+	// Wavefront mode: traces tiles breadth-first through ray queues.
+	void wavefrontSampling(int w, int h, FrameBuffer& fb);
+
+	void wavefrontTile(int x0, int y0, int x1, int y1, int w, int h,
+		unsigned int seed, FrameBuffer& fb) const;
+
+	// Times traversal of the secondary rays unsorted vs. sorted.
+	void benchmarkRaySort(int w, int h) const;
+
+	// The reconstruction filter selected by -kernel and -filter_radius.
+	Filter reconstructionFilter() const;
+
+	// Writes the cost AOV as a false-color PNG and as raw floats.
+	void saveCostMap(const Image& cost);
 
-	void vanillaSampling(int w, int h,
-		Image& image, Image& nimage, Image& dimage);
-	
-	void jitteredSampling(int w, int h,
-		Image& image, Image& nimage, Image& dimage);
-	
 	ArgParser _args;
 	SceneParser _scene;
+	LightSet _lights;
+	IrradianceCache _irradianceCache;
+
+	// requested AOVs and their output files
+	unsigned int _aovs;
+	std::string _aovFiles[AOV_COUNT];
+
+	PixelOrder::Type _pixelOrder;
+	// what the cost AOV measures
+	RenderStats::Cost _cost;
+	float _depthRange;
+	// ray cone angle of camera rays in the image being sampled, used to
+	// filter background lookups
+	float _pixelSpread;
+
+	// encodes output images in the background
+	ImageWriter _writer;
 };
 
 #endif // RENDERER_H
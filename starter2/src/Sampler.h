@@ -0,0 +1,63 @@
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include <cstdint>
+
+// Deterministic random numbers for one sample of one pixel. The stream
+// depends only on the pixel index and the sample index, so an image comes
+// out the same however pixels are split across threads or passes.
+class PixelSampler
+{
+public:
+    PixelSampler(uint32_t pixel, uint32_t sample)
+    {
+        // one PCG32 stream per pixel, started at a sample-dependent state
+        _inc = (hash(pixel) << 1) | 1u;
+        _state = 0;
+        nextBits();
+        _state += hash(sample ^ 0x9e3779b9u) | ((uint64_t)hash(pixel) << 32);
+        nextBits();
+    }
+
+    // The numbers of the path vertex at depth of sample s of a pixel, for
+    // tracers that draw afresh at each bounce. They depend on nothing
+    // else, so depth-first and wavefront tracing make the same choices
+    // however the work is scheduled.
+    static PixelSampler vertex(uint32_t pixel, uint32_t sample, uint32_t depth)
+    {
+        return PixelSampler(pixel, sample | (depth << 24));
+    }
+
+    // Uniform float in [0, 1).
+    float next()
+    {
+        return (nextBits() >> 8) * (1.0f / 16777216.0f);
+    }
+
+private:
+    // PCG-XSH-RR
+    uint32_t nextBits()
+    {
+        uint64_t old = _state;
+        _state = old * 6364136223846793005ull + _inc;
+        uint32_t xorshifted = (uint32_t)(((old >> 18) ^ old) >> 27);
+        uint32_t rot = (uint32_t)(old >> 59);
+        return (xorshifted >> rot) | (xorshifted << ((32 - rot) & 31));
+    }
+
+    // integer hash with good avalanche (lowbias32)
+    static uint32_t hash(uint32_t x)
+    {
+        x ^= x >> 16;
+        x *= 0x7feb352du;
+        x ^= x >> 15;
+        x *= 0x846ca68bu;
+        x ^= x >> 16;
+        return x;
+    }
+
+    uint64_t _state;
+    uint64_t _inc;
+};
+
+#endif // SAMPLER_H
@@ -11,6 +11,7 @@
 #include "Camera.h" 
 #include "Light.h"
 #include "Material.h"
+#include "RenderStats.h"
 
 #include "Object3D.h"
 
@@ -35,6 +36,8 @@ SceneParser::SceneParser(const std::string &filename) :
     _group(NULL),
     _cubemap(NULL)
 {
+    RenderStats::Timer timer(RenderStats::PARSE);
+
     // parse the file
     assert(!filename.empty());
 
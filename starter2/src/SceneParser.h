@@ -33,6 +33,29 @@ class SceneParser
         }
     }
 
+    // Background seen by a cone of rays spread radians wide.
+    Vector3f getBackgroundColor(const Vector3f &dir, float spread) const {
+        if (_cubemap) {
+            return _cubemap->getTexel(dir, spread);
+        } else {
+            return _background_color;
+        }
+    }
+
+    // getBackgroundColor(dir, spread) for n directions at once.
+    void getBackgroundColors(const float *dx, const float *dy, const float *dz, int n,
+                             float spread, float *r, float *g, float *b) const {
+        if (_cubemap) {
+            _cubemap->getTexels(dx, dy, dz, n, spread, r, g, b);
+            return;
+        }
+        for (int i = 0; i < n; ++i) {
+            r[i] = _background_color[0];
+            g[i] = _background_color[1];
+            b[i] = _background_color[2];
+        }
+    }
+
     const Vector3f & getAmbientLight() const {
         return _ambient_light;
     }
@@ -0,0 +1,36 @@
+#include "ShadowCache.h"
+#include "Object3D.h"
+#include "RenderStats.h"
+
+ShadowCache &
+ShadowCache::local(const Group *group)
+{
+    static thread_local ShadowCache cache;
+    if (cache._group != group) {
+        cache._group = group;
+        cache._occluder.clear();
+    }
+    return cache;
+}
+
+bool
+ShadowCache::occluded(int light, const Ray &ray, float tmin, float dist)
+{
+    Hit hit(dist, nullptr, Vector3f::ZERO);
+    Occluder &last = occluder(light);
+    if (last.object >= 0) {
+        bool blocked = _group->intersectPrimitive(last.object, last.primitive, ray, tmin, hit);
+        RenderStats::record(RenderStats::SHADOW_CACHE_TESTS, blocked);
+        if (blocked) {
+            RenderStats::record(RenderStats::SHADOW_RAYS, true);
+            return true;
+        }
+    }
+    // a lit point forgets the occluder, so the lit parts of the image
+    // pay no cache test
+    bool blocked = _group->intersect(ray, tmin, hit);
+    last.object = blocked ? hit.object : -1;
+    last.primitive = hit.primitive;
+    RenderStats::record(RenderStats::SHADOW_RAYS, blocked);
+    return blocked;
+}
@@ -0,0 +1,57 @@
+#ifndef SHADOW_CACHE_H
+#define SHADOW_CACHE_H
+
+#include <vector>
+
+class Group;
+class Ray;
+
+// Per-thread memory of the last primitive that blocked each light. Nearby
+// shading points are usually shadowed by the same primitive, so testing
+// it first often settles a shadow ray with one intersection test instead
+// of a traversal of the whole scene. A light that reaches the point
+// clears its entry, so lit parts of the image make no cache tests.
+//
+// An occluder is recorded as its top-level member of the scene group
+// plus, for meshes (also under transforms), the triangle that was hit.
+// Members without triangles, such as spheres, planes and nested groups,
+// are retested whole.
+//
+// Each render thread owns its cache, so lookups take no locks. Shadow
+// rays, and how often the cached primitive blocks them, are counted in
+// RenderStats.
+class ShadowCache
+{
+public:
+    // The calling thread's cache, emptied if it was last used for a
+    // different scene.
+    static ShadowCache &local(const Group *group);
+
+    // Whether the scene blocks the shadow ray toward light (an index into
+    // the scene's lights) before distance dist.
+    bool occluded(int light, const Ray &ray, float tmin, float dist);
+
+private:
+    struct Occluder
+    {
+        // top-level group index, or -1 if nothing is cached
+        int object;
+        // Hit::primitive of the blocking hit
+        int primitive;
+    };
+
+    ShadowCache() : _group(nullptr) {}
+
+    Occluder &occluder(int light)
+    {
+        if (light >= (int)_occluder.size()) {
+            _occluder.resize(light + 1, Occluder{ -1, -1 });
+        }
+        return _occluder[light];
+    }
+
+    const Group *_group;
+    std::vector<Occluder> _occluder;
+};
+
+#endif // SHADOW_CACHE_H
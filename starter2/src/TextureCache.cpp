@@ -0,0 +1,85 @@
+#include "TextureCache.h"
+
+TextureCache &
+TextureCache::global()
+{
+    static TextureCache cache;
+    return cache;
+}
+
+TextureCache::Key
+TextureCache::newTexture()
+{
+    static std::atomic<Key> next(1);
+    return next++ << 32;
+}
+
+TextureCache::TextureCache() :
+    _budget((size_t)256 << 20),
+    _bytes(0),
+    _peak(0),
+    _hits(0),
+    _misses(0)
+{
+}
+
+void
+TextureCache::setBudget(size_t bytes)
+{
+    _budget = bytes;
+}
+
+TextureCache::TilePtr
+TextureCache::find(Shard &shard, Key key)
+{
+    std::lock_guard<std::mutex> guard(shard.lock);
+    auto it = shard.index.find(key);
+    if (it == shard.index.end()) {
+        return TilePtr();
+    }
+    shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+    _hits.fetch_add(1, std::memory_order_relaxed);
+    return it->second->second;
+}
+
+TextureCache::TilePtr
+TextureCache::insert(Shard &shard, Key key, const TilePtr &tile)
+{
+    std::lock_guard<std::mutex> guard(shard.lock);
+    auto it = shard.index.find(key);
+    if (it != shard.index.end()) {
+        shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+        _hits.fetch_add(1, std::memory_order_relaxed);
+        return it->second->second;
+    }
+    _misses.fetch_add(1, std::memory_order_relaxed);
+
+    shard.lru.emplace_front(key, tile);
+    shard.index[key] = shard.lru.begin();
+    shard.bytes += tile->size();
+    size_t bytes = _bytes += tile->size();
+
+    // the new tile is kept even if it alone is over the shard's budget
+    const size_t budget = _budget / ShardCount;
+    while (shard.bytes > budget && shard.lru.size() > 1) {
+        const std::pair<Key, TilePtr> &last = shard.lru.back();
+        shard.bytes -= last.second->size();
+        bytes = _bytes -= last.second->size();
+        shard.index.erase(last.first);
+        shard.lru.pop_back();
+    }
+
+    size_t peak = _peak;
+    while (bytes > peak && !_peak.compare_exchange_weak(peak, bytes)) {
+    }
+    return tile;
+}
+
+void
+TextureCache::stats(long long &hits, long long &misses, size_t &bytes, size_t &peak) const
+{
+    hits = _hits;
+    misses = _misses;
+    bytes = _bytes;
+    peak = _peak;
+}
@@ -0,0 +1,89 @@
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// Fixed-budget store of texture tiles shared by all textures and render
+// threads. Tiles are loaded on demand by the caller's loader and evicted
+// least recently used first once the budget is exceeded.
+//
+// The cache is split into shards by tile key, each with its own lock and
+// LRU list, so threads fetching different tiles rarely contend. A tile is
+// handed out as a shared pointer and stays valid while it is held, even
+// after it has been evicted.
+class TextureCache
+{
+public:
+    typedef uint64_t Key;
+    typedef std::vector<uint8_t> Tile;
+    typedef std::shared_ptr<const Tile> TilePtr;
+
+    // The cache used by every CubeMap.
+    static TextureCache &global();
+
+    // A key no other texture uses, for tile 0 of level 0 of a new texture.
+    static Key newTexture();
+
+    static Key key(Key texture, int level, int tile)
+    {
+        return texture | ((Key)level << 24) | (Key)tile;
+    }
+
+    // Total bytes of tiles kept. Each shard gets an equal part, and evicts
+    // when a new tile takes it over that part.
+    void setBudget(size_t bytes);
+    size_t getBudget() const { return _budget; }
+
+    // The tile for key, calling load(tile) to fill it on a miss. load may
+    // run concurrently for different keys.
+    template<typename F>
+    TilePtr get(Key key, const F &load)
+    {
+        Shard &shard = _shards[(key ^ (key >> 24) ^ (key >> 32)) % ShardCount];
+        if (TilePtr tile = find(shard, key)) {
+            return tile;
+        }
+        // loaded outside the lock; if another thread loaded the same tile
+        // meanwhile, its copy wins
+        std::shared_ptr<Tile> tile = std::make_shared<Tile>();
+        load(*tile);
+        return insert(shard, key, tile);
+    }
+
+    // Tile requests that were and were not resident, bytes held now and
+    // the most held at once.
+    void stats(long long &hits, long long &misses, size_t &bytes, size_t &peak) const;
+
+private:
+    TextureCache();
+
+    static const int ShardCount = 16;
+
+    struct Shard
+    {
+        std::mutex lock;
+        // most recently used first
+        std::list<std::pair<Key, TilePtr> > lru;
+        std::unordered_map<Key, std::list<std::pair<Key, TilePtr> >::iterator> index;
+        size_t bytes = 0;
+    };
+
+    TilePtr find(Shard &shard, Key key);
+    TilePtr insert(Shard &shard, Key key, const TilePtr &tile);
+
+    Shard _shards[ShardCount];
+    std::atomic<size_t> _budget;
+    std::atomic<size_t> _bytes;
+    std::atomic<size_t> _peak;
+    std::atomic<long long> _hits;
+    std::atomic<long long> _misses;
+};
+
+#endif // TEXTURE_CACHE_H
@@ -48,10 +48,14 @@ class VecUtils
     }
 
     // transforms a 3D point using a matrix, returning a 3D point
+    // Only the top three rows are evaluated (no divide by w).
     static Vector3f transformPoint(const Matrix4f &mat, 
                                    const Vector3f &point)
     {
-        return (mat * Vector4f(point, 1)).xyz();
+        return Vector3f(
+            mat(0, 0) * point[0] + mat(0, 1) * point[1] + mat(0, 2) * point[2] + mat(0, 3),
+            mat(1, 0) * point[0] + mat(1, 1) * point[1] + mat(1, 2) * point[2] + mat(1, 3),
+            mat(2, 0) * point[0] + mat(2, 1) * point[1] + mat(2, 2) * point[2] + mat(2, 3));
     }
 
     // transform a 3D directino using a matrix, returning a direction
@@ -59,7 +63,10 @@ class VecUtils
     static Vector3f transformDirection(const Matrix4f &mat, 
                                        const Vector3f &dir)
     {
-        return (mat * Vector4f(dir, 0)).xyz();
+        return Vector3f(
+            mat(0, 0) * dir[0] + mat(0, 1) * dir[1] + mat(0, 2) * dir[2],
+            mat(1, 0) * dir[0] + mat(1, 1) * dir[1] + mat(1, 2) * dir[2],
+            mat(2, 0) * dir[0] + mat(2, 1) * dir[1] + mat(2, 2) * dir[2]);
     }
 };
 
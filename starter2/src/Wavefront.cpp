@@ -0,0 +1,329 @@
+#include "Renderer.h"
+
+#include "Camera.h"
+#include "Parallel.h"
+#include "PixelOrder.h"
+#include "RayQueue.h"
+#include "RaySort.h"
+#include "RenderStats.h"
+#include "Sampler.h"
+#include "ShadowCache.h"
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <random>
+
+#define eps 1e-4f
+
+/**
+ * Wavefront sampling. The image is cut into tiles that are rendered in
+ * parallel. Within a tile, all camera rays are generated into a queue,
+ * intersected together, then shaded in material order. Shading emits a
+ * queue of shadow rays, traced in bulk, and a queue of reflection rays
+ * that becomes the next wave.
+ */
+void Renderer::wavefrontSampling(int w, int h, FrameBuffer& fb){
+
+    const int tile = _args.tile_size;
+    const int tilesX = (w + tile - 1) / tile;
+    const int tilesY = (h + tile - 1) / tile;
+
+    std::vector<int> tiles;
+    PixelOrder::generate(_pixelOrder, tilesX, tilesY, tiles);
+
+    parallelFor(0, tilesX * tilesY, [&](int i) {
+        int t = tiles[i];
+        int x0 = (t % tilesX) * tile;
+        int y0 = (t / tilesX) * tile;
+        wavefrontTile(x0, y0, std::min(x0 + tile, w), std::min(y0 + tile, h),
+            w, h, (unsigned int)t + 1, fb);
+    }, _args.threads);
+}
+
+void Renderer::wavefrontTile(int x0, int y0, int x1, int y1, int w, int h,
+                             unsigned int seed, FrameBuffer& fb) const
+{
+    Camera* cam = _scene.getCamera();
+    const float tmin = cam->getTMin();
+    ShadowCache &cache = ShadowCache::local(_scene.getGroup());
+    const int tw = x1 - x0;
+    const bool shade = (_aovs & aovBit(AOV_COLOR)) != 0;
+    const bool countHits = (_aovs & aovBit(AOV_HIT_COUNT)) != 0;
+    const int samples = _args.jitter ? _args.samples : 1;
+    const float sampleWeight = 1.0f / samples;
+
+    std::minstd_rand rng(seed);
+    std::uniform_real_distribution<float> jitter(-0.5f, 0.5f);
+
+    // camera rays, in _pixelOrder; pixel indices are local to the tile
+    std::vector<int> pixels;
+    PixelOrder::generate(_pixelOrder, tw, y1 - y0, pixels);
+
+    RayQueue rays;
+    for (int p : pixels){
+        const int x = x0 + p % tw;
+        const int y = y0 + p / tw;
+        for (int s = 0; s < samples; ++s){
+            float ndcx, ndcy;
+            if (_args.jitter){
+                ndcx = 2 * ((x + 0.5f + jitter(rng)) / w) - 1.0f;
+                ndcy = 2 * ((y + 0.5f + jitter(rng)) / h) - 1.0f;
+            }
+            else{
+                ndcx = 2 * (x / (w - 1.0f)) - 1.0f;
+                ndcy = 2 * (y / (h - 1.0f)) - 1.0f;
+            }
+            Ray r = cam->generateRay(Vector2f(ndcx, ndcy));
+            rays.push(r.getOrigin(), r.getDirection(), Vector3f(sampleWeight), p, s);
+        }
+    }
+
+    RayQueue next;
+    RayQueue shadows;
+    HitQueue hits;
+    std::vector<int> order;
+    LightSample lights;
+    std::vector<float> missDir[3];
+    std::vector<float> missColor[3];
+
+    for (int depth = 0; !rays.empty(); ++depth){
+        const int n = rays.size();
+
+        // intersect the whole wave
+        hits.resize(n);
+        const RenderStats::Counter counter =
+            depth ? RenderStats::REFLECTION_RAYS : RenderStats::PRIMARY_RAYS;
+        for (int i = 0; i < n; ++i){
+            Hit hit;
+            bool found = _scene.getGroup()->intersect(rays.getRay(i), tmin, hit);
+            RenderStats::record(counter, found);
+            hits.set(i, hit);
+        }
+
+        if (depth == 0){
+            AOVSample sample;
+            for (int i = 0; i < n; ++i){
+                primaryAOVs(hits.getHit(i), sample);
+                fb.addSample(x0 + rays.pixel[i] % tw, y0 + rays.pixel[i] / tw,
+                    sample, sampleWeight);
+            }
+        }
+
+        if (countHits){
+            for (int i = 0; i < n; ++i){
+                if (hits.material[i]){
+                    fb.add(AOV_HIT_COUNT, x0 + rays.pixel[i] % tw, y0 + rays.pixel[i] / tw,
+                        Vector3f(sampleWeight / (_args.bounces + 1.0f)));
+                }
+            }
+        }
+
+        if (!shade){
+            break;
+        }
+
+        // shade in material order so each material's data stays hot
+        order.resize(n);
+        for (int i = 0; i < n; ++i){
+            order[i] = i;
+        }
+        std::sort(order.begin(), order.end(), [&](int a, int b) {
+            const Material *ma = hits.material[a];
+            const Material *mb = hits.material[b];
+            if (ma != mb){
+                // misses (null) first, then any fixed order of materials
+                return !ma || (mb && std::less<const Material*>()(ma, mb));
+            }
+            return a < b;
+        });
+
+        next.clear();
+        shadows.clear();
+
+        // rays that missed sort first; look up their background together
+        int misses = 0;
+        while (misses < n && !hits.material[order[misses]]){
+            ++misses;
+        }
+        missDir[0].resize(misses); missDir[1].resize(misses); missDir[2].resize(misses);
+        for (int k = 0; k < misses; ++k){
+            missDir[0][k] = rays.dx[order[k]];
+            missDir[1][k] = rays.dy[order[k]];
+            missDir[2][k] = rays.dz[order[k]];
+        }
+        missColor[0].resize(misses); missColor[1].resize(misses); missColor[2].resize(misses);
+        _scene.getBackgroundColors(missDir[0].data(), missDir[1].data(), missDir[2].data(),
+            misses, _pixelSpread, missColor[0].data(), missColor[1].data(), missColor[2].data());
+        for (int k = 0; k < misses; ++k){
+            const int i = order[k];
+            fb.add(AOV_COLOR, x0 + rays.pixel[i] % tw, y0 + rays.pixel[i] / tw,
+                rays.getWeight(i) * Vector3f(missColor[0][k], missColor[1][k], missColor[2][k]));
+        }
+
+        for (int k = misses; k < n; ++k){
+            const int i = order[k];
+            const int px = x0 + rays.pixel[i] % tw;
+            const int py = y0 + rays.pixel[i] / tw;
+            const Ray ray = rays.getRay(i);
+            const Vector3f weight = rays.getWeight(i);
+            Material *material = hits.material[i];
+
+            const Hit hit = hits.getHit(i);
+            const Vector3f hitPoint = ray.pointAtParameter(hit.getT());
+
+            fb.add(AOV_COLOR, px, py,
+                weight * _scene.getAmbientLight() * material->getDiffuseColor());
+
+            // the numbers traceRay draws at this hit, in the same order
+            PixelSampler sampler = PixelSampler::vertex(py * w + px, rays.sample[i], depth);
+            const float pick = sampler.next();
+            if (_args.light_pick){
+                _lights.illuminateOne(hitPoint, pick, lights);
+            }
+            else{
+                _lights.illuminate(hitPoint, _args.light_cutoff, lights);
+            }
+            material->shade(ray, hit, lights);
+            for (int lane : lights.order){
+                Vector3f contribution = weight * lights.getContribution(lane);
+                if (_args.shadows){
+                    // lights that add nothing here need no shadow ray
+                    if (!lights.isBlack(lane)){
+                        const Vector3f dirToLight = lights.getDirection(lane);
+                        shadows.push(hitPoint + eps * dirToLight, dirToLight,
+                            contribution, rays.pixel[i], rays.sample[i], lights.dist[lane],
+                            lights.light[lane]);
+                    }
+                }
+                else{
+                    fb.add(AOV_COLOR, px, py, contribution);
+                }
+            }
+
+            Vector3f throughput = weight;
+            if (depth < _args.bounces && continuePath(*material, throughput, sampler.next())){
+                Ray reflected = reflectRay(ray, hit);
+                next.push(reflected.getOrigin(), reflected.getDirection(),
+                    throughput, rays.pixel[i], rays.sample[i]);
+            }
+        }
+
+        if (_args.sort_rays){
+            sortRays(shadows);
+            sortRays(next);
+        }
+
+        // shadow rays: add the contribution of every unoccluded light.
+        // Only occluders closer than the light matter; each light's last
+        // occluder is tested first, as in shadowMask.
+        for (int i = 0; i < shadows.size(); ++i){
+            if (cache.occluded(shadows.light[i], shadows.getRay(i), tmin, shadows.tmax[i])){
+                continue;
+            }
+            fb.add(AOV_COLOR, x0 + shadows.pixel[i] % tw, y0 + shadows.pixel[i] / tw,
+                shadows.getWeight(i));
+        }
+
+        std::swap(rays, next);
+    }
+}
+
+/**
+ * Intersects every ray of q against the scene, returning the number of
+ * hits so the work cannot be optimized away.
+ */
+static int intersectQueue(const Group* group, const RayQueue& q, float tmin)
+{
+    int count = 0;
+    for (int i = 0; i < q.size(); ++i){
+        Hit hit;
+        if (group->intersect(q.getRay(i), tmin, hit)){
+            ++count;
+        }
+    }
+    return count;
+}
+
+/**
+ * Ray sorting benchmark. Collects the reflection rays of every bounce for
+ * the whole image, in the order the wavefront shader emits them, then
+ * times traversal of the same ray sets unsorted and sorted.
+ */
+void Renderer::benchmarkRaySort(int w, int h) const
+{
+    typedef std::chrono::high_resolution_clock Clock;
+    Camera* cam = _scene.getCamera();
+    const float tmin = cam->getTMin();
+    const Group* group = _scene.getGroup();
+
+    RayQueue rays;
+    for (int y = 0; y < h; ++y){
+        for (int x = 0; x < w; ++x){
+            float ndcx = 2 * (x / (w - 1.0f)) - 1.0f;
+            float ndcy = 2 * (y / (h - 1.0f)) - 1.0f;
+            Ray r = cam->generateRay(Vector2f(ndcx, ndcy));
+            rays.push(r.getOrigin(), r.getDirection(), Vector3f(1.0f), y * w + x, 0);
+        }
+    }
+
+    std::cout << "Ray sort benchmark (" << w << "x" << h << ")\n";
+    for (int depth = 0; depth < _args.bounces && !rays.empty(); ++depth){
+        const int n = rays.size();
+        std::vector<Hit> hits(n);
+        std::vector<int> order(n);
+        for (int i = 0; i < n; ++i){
+            group->intersect(rays.getRay(i), tmin, hits[i]);
+            order[i] = i;
+        }
+        std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+            return std::less<const Material*>()(hits[a].material, hits[b].material);
+        });
+
+        RayQueue next;
+        for (int i : order){
+            Vector3f throughput = rays.getWeight(i);
+            // skip the light pick the shader draws first
+            PixelSampler sampler = PixelSampler::vertex(rays.pixel[i], 0, depth);
+            sampler.next();
+            if (hits[i].material && continuePath(*hits[i].material, throughput, sampler.next())){
+                Ray reflected = reflectRay(rays.getRay(i), hits[i]);
+                next.push(reflected.getOrigin(), reflected.getDirection(),
+                    throughput, rays.pixel[i], 0);
+            }
+        }
+        if (next.empty()){
+            break;
+        }
+
+        // best of three runs for each variant
+        const int runs = 3;
+        double sortTime = 0, unsortedTime = 0, sortedTime = 0;
+        int hitsUnsorted = 0, hitsSorted = 0;
+        for (int run = 0; run < runs; ++run){
+            RayQueue sorted = next;
+            Clock::time_point t0 = Clock::now();
+            sortRays(sorted);
+            Clock::time_point t1 = Clock::now();
+            hitsUnsorted = intersectQueue(group, next, tmin);
+            Clock::time_point t2 = Clock::now();
+            hitsSorted = intersectQueue(group, sorted, tmin);
+            Clock::time_point t3 = Clock::now();
+
+            double ts = std::chrono::duration<double>(t1 - t0).count();
+            double tu = std::chrono::duration<double>(t2 - t1).count();
+            double to = std::chrono::duration<double>(t3 - t2).count();
+            sortTime = run ? std::min(sortTime, ts) : ts;
+            unsortedTime = run ? std::min(unsortedTime, tu) : tu;
+            sortedTime = run ? std::min(sortedTime, to) : to;
+        }
+        std::cout << "- bounce " << depth + 1 << ": " << next.size() << " rays, "
+            << hitsUnsorted << "/" << hitsSorted << " hits\n"
+            << "    unsorted: " << next.size() / unsortedTime / 1e6 << " Mrays/s\n"
+            << "    sorted:   " << next.size() / sortedTime / 1e6 << " Mrays/s"
+            << " (+" << sortTime * 1e3 << " ms sort)\n";
+
+        std::swap(rays, next);
+    }
+}
@@ -2,8 +2,51 @@
 #include <iostream>
 
 #include "ArgParser.h"
+#include "ImageCompare.h"
 #include "Renderer.h"
 
+// -compare mode: prints the error metrics of an image against a reference
+// and returns 0 if every given threshold is met, 1 otherwise.
+static int
+compareImages(const ArgParser &args)
+{
+    Image test = ImageCompare::load(args.compare_file);
+    Image reference = ImageCompare::load(args.reference_file);
+    if (test.getWidth() == 0 || reference.getWidth() == 0) {
+        std::cout << "Error: could not read "
+            << (test.getWidth() == 0 ? args.compare_file : args.reference_file) << "\n";
+        return 1;
+    }
+    if (test.getWidth() != reference.getWidth() || test.getHeight() != reference.getHeight()) {
+        std::cout << "FAIL: size " << test.getWidth() << "x" << test.getHeight()
+            << " differs from " << reference.getWidth() << "x" << reference.getHeight() << "\n";
+        return 1;
+    }
+
+    ImageMetrics m;
+    Image diff;
+    ImageCompare::compare(test, reference, m, args.diff_file.size() ? &diff : nullptr);
+    if (args.diff_file.size()) {
+        bool written = true;
+        if (Image::isPFM(args.diff_file)) {
+            written = diff.savePFM(args.diff_file);
+        } else {
+            diff.savePNG(args.diff_file);
+        }
+        if (!written) {
+            std::cout << "Error: could not write " << args.diff_file << "\n";
+        }
+    }
+
+    bool pass = (args.max_error < 0 || m.maxError <= args.max_error) &&
+        (args.min_psnr < 0 || m.psnr >= args.min_psnr) &&
+        (args.min_ssim < 0 || m.ssim >= args.min_ssim);
+    std::cout << (pass ? "PASS" : "FAIL") << " " << args.compare_file
+        << ": max " << m.maxError << ", mean " << m.meanError
+        << ", PSNR " << m.psnr << " dB, SSIM " << m.ssim << "\n";
+    return pass ? 0 : 1;
+}
+
 int
 main(int argc, const char *argv[])
 {
@@ -17,14 +60,53 @@ main(int argc, const char *argv[])
             << "\t-output <image.png>\n"
             << "\t[-depth <depth_min> <depth_max> <depth_image.png>\n]"
             << "\t[-normals <normals_image.png>]\n"
+            << "\t[-objectid <objectid_image.png>]\n"
+            << "\t[-materialid <materialid_image.png>]\n"
+            << "\t[-hitcount <hitcount_image.png>]\n"
+            << "\t[-cost <nodes|tests|time> <cost_image.png>]\n"
+            << "\t[-layers <frame.layers>]\n"
+            << "\t[-layers_half]\n"
+            << "\t[-png_compression <level>]\n"
+            << "\t[-stats]\n"
+            << "\t[-stats_json <stats.json>]\n"
             << "\t[-bounces <max_bounces>\n]"
             << "\t[-shadows\n]"
+            << "\t[-rr_threshold <min_path_weight>]\n"
+            << "\t[-light_cutoff <min_light_intensity>]\n"
+            << "\t[-light_pick]\n"
+            << "\t[-jitter]\n"
+            << "\t[-samples <samples_per_pixel>]\n"
+            << "\t[-filter]\n"
+            << "\t[-supersample <factor>]\n"
+            << "\t[-kernel <box|tent|gaussian|mitchell|lanczos|binomial>]\n"
+            << "\t[-filter_radius <pixels>]\n"
+            << "\t[-path_trace]\n"
+            << "\t[-progressive]\n"
+            << "\t[-irradiance_cache]\n"
+            << "\t[-ic_error <max_error>]\n"
+            << "\t[-ic_samples <rays_per_record>]\n"
+            << "\t[-texture_cache <megabytes>]\n"
+            << "\t[-texture_cache_dir <directory>]\n"
+            << "\t[-wavefront]\n"
+            << "\t[-tile_size <pixels>]\n"
+            << "\t[-pixel_order <scanline|morton|hilbert>]\n"
+            << "\t[-threads <count>]\n"
+            << "\t[-sort_rays]\n"
+            << "\t[-bench_sort]\n"
+            << "\t[-denoise]\n"
+            << "\n"
+            << "Compare: a5 -compare <image> <reference> [-diff <diff_image>]\n"
+            << "\t[-max_error <e>] [-min_psnr <dB>] [-min_ssim <s>]\n"
+            << "\t(PNG or PFM; exits with 1 if a threshold is not met)\n"
             << "\n"
             ;
         return 1;
     }
 
     ArgParser argsParser(argc, argv);
+    if (argsParser.compare_file.size()) {
+        return compareImages(argsParser);
+    }
     Renderer renderer(argsParser);
     renderer.Render();
     return 0;
@@ -80,6 +80,10 @@ USAGE:
    TGA supports RLE or non-RLE compressed data. To use non-RLE-compressed
    data, set the global variable 'stbi_write_tga_with_rle' to 0.
 
+   PNG is deflated at the level in the global variable
+   'stbi_write_png_compression_level' (default 8). Higher levels give
+   smaller files but take longer and use more memory.
+
 CREDITS:
 
    PNG/BMP/TGA
@@ -119,6 +123,7 @@ extern "C" {
 #else
 #define STBIWDEF extern
 extern int stbi_write_tga_with_rle;
+extern int stbi_write_png_compression_level;
 #endif
 
 #ifndef STBI_WRITE_NO_STDIO
@@ -223,8 +228,10 @@ typedef int stb_image_write_test[sizeof(stbiw_uint32)==4 ? 1 : -1];
 
 #ifdef STB_IMAGE_WRITE_STATIC
 static int stbi_write_tga_with_rle = 1;
+static int stbi_write_png_compression_level = 8;
 #else
 int stbi_write_tga_with_rle = 1;
+int stbi_write_png_compression_level = 8;
 #endif
 
 static void stbiw__writefv(stbi__write_context *s, const char *fmt, va_list v)
@@ -905,7 +912,7 @@ unsigned char *stbi_write_png_to_mem(unsigned char *pixels, int stride_bytes, in
       STBIW_MEMMOVE(filt+j*(x*n+1)+1, line_buffer, x*n);
    }
    STBIW_FREE(line_buffer);
-   zlib = stbi_zlib_compress(filt, y*( x*n+1), &zlen, 8); // increase 8 to get smaller but use more memory
+   zlib = stbi_zlib_compress(filt, y*( x*n+1), &zlen, stbi_write_png_compression_level); // increase to get smaller but use more memory
    STBIW_FREE(filt);
    if (!zlib) return 0;
 
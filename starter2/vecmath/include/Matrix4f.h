@@ -3,29 +3,38 @@
 
 #include <cstdio>
 
+#include "Vector3f.h"
+#include "Vector4f.h"
+#include "VecmathSIMD.h"
+
 class Matrix2f;
 class Matrix3f;
 class Quat4f;
-class Vector3f;
-class Vector4f;
 
 // 4x4 Matrix, stored in column major order (OpenGL style)
+// Element access and the products are defined inline below; with
+// VECMATH_SIMD the columns are 16-byte aligned and the products use
+// SSE / NEON.
 class Matrix4f
 {
 public:
     // Fill a 4x4 matrix with "fill".  Default to 0.
-    explicit Matrix4f(float fill = 0.f);
-    Matrix4f(float m00, float m01, float m02, float m03,
+    constexpr explicit Matrix4f(float fill = 0.f) :
+        m_elements{ fill, fill, fill, fill, fill, fill, fill, fill,
+            fill, fill, fill, fill, fill, fill, fill, fill } {}
+    constexpr Matrix4f(float m00, float m01, float m02, float m03,
         float m10, float m11, float m12, float m13,
         float m20, float m21, float m22, float m23,
-        float m30, float m31, float m32, float m33);
+        float m30, float m31, float m32, float m33) :
+        m_elements{ m00, m10, m20, m30, m01, m11, m21, m31,
+            m02, m12, m22, m32, m03, m13, m23, m33 } {}
 
     // setColumns = true ==> sets the columns of the matrix to be [v0 v1 v2 v3]
     // otherwise, sets the rows
     Matrix4f(const Vector4f& v0, const Vector4f& v1, const Vector4f& v2, const Vector4f& v3, bool setColumns = true);
 
-    Matrix4f(const Matrix4f& rm); // copy constructor
-    Matrix4f& operator = (const Matrix4f& rm); // assignment operator
+    Matrix4f(const Matrix4f& rm) = default; // copy constructor
+    Matrix4f& operator = (const Matrix4f& rm) = default; // assignment operator
     Matrix4f& operator/=(float d);
     // no destructor necessary
 
@@ -56,8 +65,43 @@ public:
     void setSubmatrix3x3(int i0, int j0, const Matrix3f& m);
 
     float determinant() const;
+
+    // Uses inverseAffine() when the matrix is affine, otherwise a full
+    // cofactor expansion.
     Matrix4f inverse(bool* pbIsSingular = NULL, float epsilon = 0.f) const;
 
+    // An affine matrix has a bottom row of exactly [0 0 0 1]. A rigid one
+    // is affine and its upper-left 3x3 block is orthonormal to within
+    // epsilon (a rotation, possibly with a reflection, plus a translation).
+    bool isAffine() const;
+    bool isRigid(float epsilon = 1e-5f) const;
+
+    // Inverse of an affine matrix [A t; 0 1]: [A^-1  -A^-1 t; 0 1].
+    // Only the 3x3 block is inverted.
+    Matrix4f inverseAffine(bool* pbIsSingular = NULL, float epsilon = 0.f) const;
+
+    // Inverse of a rigid matrix [R t; 0 1]: [R^T  -R^T t; 0 1].
+    // Never picked automatically: for a block that is only orthonormal to
+    // within epsilon the transpose is an approximation, so check isRigid()
+    // and opt in.
+    Matrix4f inverseRigid() const;
+
+    // Batch transforms of n 3D vectors, the i-th one being
+    // (x[i * stride], y[i * stride], z[i * stride]).
+    // stride = 1 with three separate arrays is structure-of-arrays layout
+    // and is vectorized when vecmath is built with VECMATH_SIMD; stride = 3
+    // with x, x + 1, x + 2 walks an array of Vector3f in place.
+    // The outputs use the same layout and may alias the inputs.
+    // Points use the affine part and, like VecUtils::transformPoint, are not
+    // divided by w. Directions use the upper-left 3x3 block, normals its
+    // inverse transpose (not renormalized).
+    void transformPoints(const float* x, const float* y, const float* z,
+        float* outX, float* outY, float* outZ, int n, int stride = 1) const;
+    void transformDirections(const float* x, const float* y, const float* z,
+        float* outX, float* outY, float* outZ, int n, int stride = 1) const;
+    void transformNormals(const float* x, const float* y, const float* z,
+        float* outX, float* outY, float* outZ, int n, int stride = 1) const;
+
     void transpose();
     Matrix4f transposed() const;
 
@@ -94,7 +138,13 @@ public:
 
 private:
 
-    float m_elements[16];
+    // out = m.col(0) * v[0] + ... + m.col(3) * v[3]; shared by both products
+    static void mulColumns(const float* m, const float* v, float* out);
+
+    friend Vector4f operator * (const Matrix4f& m, const Vector4f& v);
+    friend Matrix4f operator * (const Matrix4f& x, const Matrix4f& y);
+
+    VECMATH_ALIGN float m_elements[16];
 
 };
 
@@ -109,5 +159,143 @@ Matrix4f operator * (const Matrix4f& x, const Matrix4f& y);
 Matrix4f operator * (const Matrix4f& m, float f);
 Matrix4f operator * (float f, const Matrix4f& m);
 
+//////////////////////////////////////////////////////////////////////////
+// Inline definitions
+//////////////////////////////////////////////////////////////////////////
+
+inline const float& Matrix4f::operator () (int i, int j) const
+{
+    return m_elements[j * 4 + i];
+}
+
+inline float& Matrix4f::operator () (int i, int j)
+{
+    return m_elements[j * 4 + i];
+}
+
+inline Vector4f Matrix4f::getRow(int i) const
+{
+    return Vector4f(m_elements[i], m_elements[i + 4], m_elements[i + 8], m_elements[i + 12]);
+}
+
+inline void Matrix4f::setRow(int i, const Vector4f& v)
+{
+    m_elements[i] = v.x();
+    m_elements[i + 4] = v.y();
+    m_elements[i + 8] = v.z();
+    m_elements[i + 12] = v.w();
+}
+
+inline Vector4f Matrix4f::getCol(int j) const
+{
+    int colStart = 4 * j;
+    return Vector4f(m_elements[colStart], m_elements[colStart + 1],
+        m_elements[colStart + 2], m_elements[colStart + 3]);
+}
+
+inline void Matrix4f::setCol(int j, const Vector4f& v)
+{
+    int colStart = 4 * j;
+    m_elements[colStart] = v.x();
+    m_elements[colStart + 1] = v.y();
+    m_elements[colStart + 2] = v.z();
+    m_elements[colStart + 3] = v.w();
+}
+
+inline void Matrix4f::transpose()
+{
+    for (int i = 0; i < 3; ++i) {
+        for (int j = i + 1; j < 4; ++j) {
+            float temp = (*this)(i, j);
+            (*this)(i, j) = (*this)(j, i);
+            (*this)(j, i) = temp;
+        }
+    }
+}
+
+inline Matrix4f Matrix4f::transposed() const
+{
+    Matrix4f out(*this);
+    out.transpose();
+    return out;
+}
+
+inline Matrix4f::operator float* ()
+{
+    return m_elements;
+}
+
+inline Matrix4f::operator const float* () const
+{
+    return m_elements;
+}
+
+// static
+inline Matrix4f Matrix4f::identity()
+{
+    return Matrix4f(1, 0, 0, 0,
+        0, 1, 0, 0,
+        0, 0, 1, 0,
+        0, 0, 0, 1);
+}
+
+// Column j of x * y is x * y.getCol(j), so both products share this
+// kernel. Terms are accumulated in column order in every backend.
+// static
+inline void Matrix4f::mulColumns(const float* m, const float* v, float* out)
+{
+#if defined( VECMATH_SSE )
+    __m128 r = _mm_mul_ps(_mm_load_ps(m), _mm_set1_ps(v[0]));
+    r = _mm_add_ps(r, _mm_mul_ps(_mm_load_ps(m + 4), _mm_set1_ps(v[1])));
+    r = _mm_add_ps(r, _mm_mul_ps(_mm_load_ps(m + 8), _mm_set1_ps(v[2])));
+    r = _mm_add_ps(r, _mm_mul_ps(_mm_load_ps(m + 12), _mm_set1_ps(v[3])));
+    _mm_store_ps(out, r);
+#elif defined( VECMATH_NEON )
+    // separate multiply and add: a fused multiply-add would round differently
+    float32x4_t r = vmulq_n_f32(vld1q_f32(m), v[0]);
+    r = vaddq_f32(r, vmulq_n_f32(vld1q_f32(m + 4), v[1]));
+    r = vaddq_f32(r, vmulq_n_f32(vld1q_f32(m + 8), v[2]));
+    r = vaddq_f32(r, vmulq_n_f32(vld1q_f32(m + 12), v[3]));
+    vst1q_f32(out, r);
+#else
+    for (int i = 0; i < 4; ++i) {
+        out[i] = m[i] * v[0] + m[i + 4] * v[1] + m[i + 8] * v[2] + m[i + 12] * v[3];
+    }
+#endif
+}
+
+inline Vector4f operator * (const Matrix4f& m, const Vector4f& v)
+{
+    Vector4f output;
+    Matrix4f::mulColumns(m, v, output);
+    return output;
+}
+
+inline Matrix4f operator * (const Matrix4f& x, const Matrix4f& y)
+{
+    Matrix4f product;
+    const float* ye = y;
+    float* pe = product;
+    for (int k = 0; k < 4; ++k) {
+        Matrix4f::mulColumns(x, ye + 4 * k, pe + 4 * k);
+    }
+    return product;
+}
+
+inline Matrix4f operator * (const Matrix4f& m, float f)
+{
+    Matrix4f product(m);
+    float* pe = product;
+    for (int i = 0; i < 16; ++i) {
+        pe[i] *= f;
+    }
+    return product;
+}
+
+inline Matrix4f operator * (float f, const Matrix4f& m)
+{
+    return m * f;
+}
+
 
 #endif // MATRIX4F_H